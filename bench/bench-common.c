@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "bench-common.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void bench_rng_seed(BenchRng *rng, uint64_t seed) { rng->state = seed ? seed : 0x9e3779b97f4a7c15; }
+
+// xorshift64*
+uint64_t bench_rng_next(BenchRng *rng) {
+  uint64_t x = rng->state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  rng->state = x;
+  return x * 0x2545f4914f6cdd1d;
+}
+
+uint32_t bench_rng_below(BenchRng *rng, uint32_t limit) {
+  return limit ? (uint32_t)((bench_rng_next(rng) >> 32) % limit) : 0;
+}
+
+size_t bench_base64_encode(const unsigned char *in, size_t len, char *out) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t i, o = 0;
+  for (i = 0; i + 2 < len; i += 3) {
+    uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+    out[o++] = alphabet[(v >> 18) & 0x3f];
+    out[o++] = alphabet[(v >> 12) & 0x3f];
+    out[o++] = alphabet[(v >> 6) & 0x3f];
+    out[o++] = alphabet[v & 0x3f];
+  }
+  if (i < len) {
+    uint32_t v = (uint32_t)in[i] << 16;
+    if (i + 1 < len)
+      v |= (uint32_t)in[i + 1] << 8;
+    out[o++] = alphabet[(v >> 18) & 0x3f];
+    out[o++] = alphabet[(v >> 12) & 0x3f];
+    out[o++] = i + 1 < len ? alphabet[(v >> 6) & 0x3f] : '=';
+    out[o++] = '=';
+  }
+  return o;
+}
+
+// A minimal binary plist writer -- just enough for bench_make_copl(). Objects are written in
+// order, so a container must be added after everything it refers to. Object references and
+// counts are single bytes, so there can be at most 255 objects and 14 entries in a dict.
+
+#define COPL_MAX_OBJECTS 64
+
+typedef struct {
+  unsigned char *buf;
+  size_t capacity;
+  size_t length;
+  int overflow;
+  uint32_t offsets[COPL_MAX_OBJECTS];
+  int count;
+} PlistWriter;
+
+static void put(PlistWriter *w, const void *p, size_t n) {
+  if (w->length + n > w->capacity) {
+    w->overflow = 1;
+    return;
+  }
+  memcpy(w->buf + w->length, p, n);
+  w->length += n;
+}
+
+static void put_be(PlistWriter *w, uint64_t v, int size) {
+  unsigned char b[8];
+  for (int i = 0; i < size; i++)
+    b[i] = (unsigned char)(v >> (8 * (size - 1 - i)));
+  put(w, b, size);
+}
+
+static int begin_object(PlistWriter *w) {
+  if (w->count == COPL_MAX_OBJECTS) {
+    w->overflow = 1;
+    return 0;
+  }
+  w->offsets[w->count] = (uint32_t)w->length;
+  return w->count++;
+}
+
+static int add_string(PlistWriter *w, const char *s) {
+  int ref = begin_object(w);
+  size_t n = strlen(s);
+  if (n > 255)
+    n = 255;
+  if (n < 15) {
+    put_be(w, 0x50 | n, 1);
+  } else {
+    put_be(w, 0x5f, 1);
+    put_be(w, 0x10, 1);
+    put_be(w, n, 1);
+  }
+  put(w, s, n);
+  return ref;
+}
+
+static int add_int(PlistWriter *w, int64_t v) {
+  int ref = begin_object(w);
+  put_be(w, 0x13, 1);
+  put_be(w, (uint64_t)v, 8);
+  return ref;
+}
+
+static int add_real(PlistWriter *w, double v) {
+  int ref = begin_object(w);
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  put_be(w, 0x23, 1);
+  put_be(w, bits, 8);
+  return ref;
+}
+
+static int add_dict(PlistWriter *w, int n, const int *keys, const int *values) {
+  int ref = begin_object(w);
+  put_be(w, 0xd0 | n, 1);
+  for (int i = 0; i < n; i++)
+    put_be(w, keys[i], 1);
+  for (int i = 0; i < n; i++)
+    put_be(w, values[i], 1);
+  return ref;
+}
+
+static size_t finish(PlistWriter *w, int top) {
+  size_t offset_table = w->length;
+  for (int i = 0; i < w->count; i++)
+    put_be(w, w->offsets[i], 4);
+  put_be(w, 0, 6);      // unused
+  put_be(w, 4, 1);      // offset size
+  put_be(w, 1, 1);      // object reference size
+  put_be(w, w->count, 8);
+  put_be(w, top, 8);
+  put_be(w, offset_table, 8);
+  return w->overflow ? 0 : w->length;
+}
+
+size_t bench_make_copl(unsigned char *buf, size_t capacity, uint32_t seq) {
+  PlistWriter w = {.buf = buf, .capacity = capacity};
+  char title[64], artist[64], album[64];
+  snprintf(title, sizeof(title), "Track %u of the benchmark", seq);
+  snprintf(artist, sizeof(artist), "Artist %u", seq % 97);
+  snprintf(album, sizeof(album), "Album %u - Deluxe Edition", seq % 13);
+  put(&w, "bplist00", 8);
+  int keys[8], values[8];
+  keys[0] = add_string(&w, "kMRMediaRemoteNowPlayingInfoTitle");
+  values[0] = add_string(&w, title);
+  keys[1] = add_string(&w, "kMRMediaRemoteNowPlayingInfoArtist");
+  values[1] = add_string(&w, artist);
+  keys[2] = add_string(&w, "kMRMediaRemoteNowPlayingInfoAlbum");
+  values[2] = add_string(&w, album);
+  keys[3] = add_string(&w, "kMRMediaRemoteNowPlayingInfoDuration");
+  values[3] = add_real(&w, 180.0 + seq % 240);
+  keys[4] = add_string(&w, "kMRMediaRemoteNowPlayingInfoElapsedTime");
+  values[4] = add_real(&w, (seq % 180) + 0.25);
+  keys[5] = add_string(&w, "kMRMediaRemoteNowPlayingInfoPlaybackRate");
+  values[5] = add_int(&w, 1);
+  keys[6] = add_string(&w, "kMRMediaRemoteNowPlayingInfoTrackNumber");
+  values[6] = add_int(&w, 1 + seq % 20);
+  keys[7] = add_string(&w, "kMRMediaRemoteNowPlayingInfoUniqueIdentifier");
+  values[7] = add_int(&w, 0x100000000LL + seq);
+  int params = add_dict(&w, 8, keys, values);
+  int top_keys[2], top_values[2];
+  top_keys[0] = add_string(&w, "type");
+  top_values[0] = add_string(&w, "updateNowPlaying");
+  top_keys[1] = add_string(&w, "params");
+  top_values[1] = params;
+  int top = add_dict(&w, 2, top_keys, top_values);
+  return finish(&w, top);
+}
+
+uint64_t bench_now_ns(void) {
+  struct timespec tn;
+  clock_gettime(CLOCK_MONOTONIC, &tn);
+  return (uint64_t)tn.tv_sec * 1000000000 + tn.tv_nsec;
+}
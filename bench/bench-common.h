@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Helpers shared by the benchmark programs: a small deterministic random number generator,
+// a base64 encoder and a builder for "copl"-style binary plists.
+
+typedef struct {
+  uint64_t state;
+} BenchRng;
+
+void bench_rng_seed(BenchRng *rng, uint64_t seed);
+uint64_t bench_rng_next(BenchRng *rng);
+// a number from 0 to limit - 1
+uint32_t bench_rng_below(BenchRng *rng, uint32_t limit);
+
+// Encode len bytes of in into out, which must hold at least BENCH_BASE64_LENGTH(len) bytes.
+// Returns the number of characters written. The output isn't NUL-terminated.
+#define BENCH_BASE64_LENGTH(len) (4 * (((len) + 2) / 3))
+size_t bench_base64_encode(const unsigned char *in, size_t len, char *out);
+
+// Build a binary plist like the "updateNowPlaying" command messages that arrive as ssnc/copl
+// items, with the track details varying with seq. Returns its length, or 0 if it won't fit.
+size_t bench_make_copl(unsigned char *buf, size_t capacity, uint32_t seq);
+
+// a monotonic clock reading, in nanoseconds
+uint64_t bench_now_ns(void);
@@ -0,0 +1,159 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Microbenchmarks for the base64 decoder, the binary plist parser and printers and the JSON
+// string escaper.
+// Each one is run repeatedly for at least BENCH_MIN_SECONDS and the time per call reported.
+
+#include "../utilities/base64.h"
+#include "../utilities/bplist-print.h"
+#include "../utilities/json.h"
+#include "bench-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MIN_SECONDS 0.5
+
+typedef void (*BenchFunction)(void *context);
+
+// run f until BENCH_MIN_SECONDS have passed, returning the average nanoseconds per call
+static double run(BenchFunction f, void *context) {
+  uint64_t calls = 0, batch = 1;
+  uint64_t started = bench_now_ns(), elapsed;
+  do {
+    for (uint64_t i = 0; i < batch; i++)
+      f(context);
+    calls += batch;
+    batch *= 2;
+    elapsed = bench_now_ns() - started;
+  } while (elapsed < BENCH_MIN_SECONDS * 1e9);
+  return (double)elapsed / calls;
+}
+
+static void report(const char *name, double ns_per_call, size_t bytes) {
+  if (bytes)
+    printf("%-36s %12.1f ns/call %10.1f MB/s\n", name, ns_per_call, bytes / ns_per_call * 1e3);
+  else
+    printf("%-36s %12.1f ns/call\n", name, ns_per_call);
+}
+
+typedef struct {
+  int (*decode)(const unsigned char *, size_t, unsigned char *, size_t *);
+  const char *encoded;
+  size_t encoded_length;
+  unsigned char *decoded;
+  size_t capacity;
+} Base64Context;
+
+static void bench_base64(void *context) {
+  Base64Context *c = context;
+  size_t length = c->capacity;
+  if (c->decode((const unsigned char *)c->encoded, c->encoded_length, c->decoded, &length) != 0)
+    die("the base64 decoder rejected the benchmark data");
+}
+
+typedef struct {
+  const char *buf;
+  size_t length;
+  FILE *out;
+} PlistContext;
+
+static void bench_plist_parse(void *context) {
+  PlistContext *c = context;
+  PlistNode *root = plist_parse_binary(c->buf, c->length);
+  if (root == NULL)
+    die("the plist parser rejected the benchmark plist");
+  plist_free(root);
+}
+
+static void bench_plist_print(void *context) {
+  PlistContext *c = context;
+  fpretty_print_binary_plist(c->out, c->buf, c->length, 1);
+}
+
+static void bench_plist_json(void *context) {
+  PlistContext *c = context;
+  fprint_binary_plist_json(c->out, c->buf, c->length, 0);
+}
+
+static void bench_json_string(void *context) {
+  PlistContext *c = context;
+  json_print_string(c->out, c->buf, c->length);
+}
+
+int main(void) {
+  debug_init(0, 0, 1, 1);
+  base64_init();
+  BenchRng rng;
+  bench_rng_seed(&rng, 1);
+  printf("base64 decoder: %s\n", base64_decoder_name());
+
+  // base64: a short text tag, a copl-sized payload and a large picture
+  static const size_t sizes[] = {24, 400, 300000};
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t n = sizes[s];
+    unsigned char *raw = malloc(n);
+    char *encoded = malloc(BENCH_BASE64_LENGTH(n));
+    if ((raw == NULL) || (encoded == NULL))
+      die("could not allocate the base64 benchmark data");
+    for (size_t i = 0; i < n; i++)
+      raw[i] = bench_rng_below(&rng, 256);
+    Base64Context c = {.encoded = encoded, .decoded = raw, .capacity = n};
+    c.encoded_length = bench_base64_encode(raw, n, encoded);
+    char name[64];
+    c.decode = base64_decode;
+    snprintf(name, sizeof(name), "base64_decode %zu bytes", n);
+    report(name, run(bench_base64, &c), c.encoded_length);
+    c.decode = base64_decode_scalar;
+    snprintf(name, sizeof(name), "base64_decode_scalar %zu bytes", n);
+    report(name, run(bench_base64, &c), c.encoded_length);
+    free(encoded);
+    free(raw);
+  }
+
+  // plists: a copl command message
+  unsigned char copl[4096];
+  PlistContext c = {.buf = (const char *)copl};
+  c.length = bench_make_copl(copl, sizeof(copl), 1);
+  c.out = fopen("/dev/null", "w");
+  if (c.out == NULL)
+    die("could not open /dev/null");
+  report("plist_parse_binary (copl)", run(bench_plist_parse, &c), c.length);
+  report("fpretty_print_binary_plist (copl)", run(bench_plist_print, &c), c.length);
+  report("fprint_binary_plist_json (copl)", run(bench_plist_json, &c), c.length);
+
+  // JSON strings: a typical title, in ASCII and with accented letters
+  static const char *const titles[] = {
+      "Stabat Mater: I. Stabat mater dolorosa (Live at the Royal Albert Hall)",
+      "Stabat Mater: I. Stabat mater dolorosa (Live à la Salle Pleyel, Paris)"};
+  for (size_t t = 0; t < sizeof(titles) / sizeof(titles[0]); t++) {
+    c.buf = titles[t];
+    c.length = strlen(titles[t]);
+    report(t == 0 ? "json_print_string (ASCII title)" : "json_print_string (UTF-8 title)",
+           run(bench_json_string, &c), c.length);
+  }
+  fclose(c.out);
+  return 0;
+}
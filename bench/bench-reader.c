@@ -0,0 +1,269 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Feeds a metadata stream through the reader and reports how it performed.
+//
+// First the whole stream is piped through the reader as fast as it will take it, and the
+// throughput (items/s and MB/s of input) and the reader's peak resident set size are reported.
+// Then, with a fresh reader, items are sent one at a time, each followed by a probe -- an
+// ssnc/mden item -- and the time until the probe's output comes back is the latency of that item.
+// The median (p50) and p99 of these are reported. Because the probe ends a metadata bundle, the
+// reader flushes its output straight away, so its batching doesn't count towards the latency.
+
+#define _GNU_SOURCE // for memmem()
+#include "bench-common.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// "bench-probe", base64 encoded
+static const char probe_item[] = "<item><type>73736e63</type><code>6d64656e</code><length>11</length>\n"
+                                 "<data encoding=\"base64\">\nYmVuY2gtcHJvYmU=</data></item>\n";
+static const char probe_output[] = "Metadata bundle \"bench-probe\" end.";
+
+typedef struct {
+  pid_t pid;
+  int to_reader;   // the reader's stdin
+  int from_reader; // the reader's stdout
+  char tail[sizeof(probe_output)]; // the end of the output so far, to find a probe split by reads
+  size_t tail_length;
+  uint64_t output_bytes;
+} Reader;
+
+static void start_reader(Reader *r, char **reader_argv) {
+  int in[2], out[2];
+  if ((pipe(in) != 0) || (pipe(out) != 0))
+    die("could not create a pipe: %s", strerror(errno));
+  r->pid = fork();
+  if (r->pid < 0)
+    die("could not fork: %s", strerror(errno));
+  if (r->pid == 0) {
+    dup2(in[0], STDIN_FILENO);
+    dup2(out[1], STDOUT_FILENO);
+    close(in[0]);
+    close(in[1]);
+    close(out[0]);
+    close(out[1]);
+    execv(reader_argv[0], reader_argv);
+    fprintf(stderr, "could not run \"%s\": %s\n", reader_argv[0], strerror(errno));
+    _exit(127);
+  }
+  close(in[0]);
+  close(out[1]);
+  r->to_reader = in[1];
+  r->from_reader = out[0];
+  fcntl(r->to_reader, F_SETFL, O_NONBLOCK);
+  r->tail_length = 0;
+  r->output_bytes = 0;
+}
+
+// Read what output there is, returning the number of probes seen, or -1 at the end of it.
+static int drain(Reader *r) {
+  char buf[65536 + sizeof(probe_output)];
+  int probes = 0;
+  memcpy(buf, r->tail, r->tail_length);
+  ssize_t n = read(r->from_reader, buf + r->tail_length, 65536);
+  if (n < 0)
+    return errno == EINTR ? 0 : -1;
+  if (n == 0)
+    return -1;
+  r->output_bytes += n;
+  size_t length = r->tail_length + n;
+  char *p = buf;
+  while ((p = memmem(p, length - (p - buf), probe_output, sizeof(probe_output) - 1)) != NULL) {
+    probes++;
+    p += sizeof(probe_output) - 1;
+  }
+  // keep enough of the end to find a probe split across reads, but not one already counted
+  size_t keep = sizeof(probe_output) - 2;
+  if (keep > length)
+    keep = length;
+  if ((probes > 0) && (buf + length - keep < p))
+    keep = buf + length - p;
+  memcpy(r->tail, buf + length - keep, keep);
+  r->tail_length = keep;
+  return probes;
+}
+
+// Write all of data to the reader while draining its output, so that neither side blocks.
+// If wait_for_probes is non-zero, carry on draining until that many probes have come back.
+static void pump(Reader *r, const char *data, size_t length, int wait_for_probes) {
+  size_t written = 0;
+  int probes = 0;
+  while ((written < length) || (probes < wait_for_probes)) {
+    struct pollfd pfd[2] = {{.fd = r->from_reader, .events = POLLIN},
+                            {.fd = r->to_reader, .events = POLLOUT}};
+    int nfds = written < length ? 2 : 1;
+    if (poll(pfd, nfds, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      die("poll failed: %s", strerror(errno));
+    }
+    if (pfd[0].revents) {
+      int seen = drain(r);
+      if (seen < 0)
+        die("the reader stopped unexpectedly");
+      probes += seen;
+    }
+    if ((nfds == 2) && pfd[1].revents) {
+      ssize_t n = write(r->to_reader, data + written, length - written);
+      if (n > 0)
+        written += n;
+      else if ((n < 0) && (errno != EAGAIN) && (errno != EINTR))
+        die("could not write to the reader: %s", strerror(errno));
+    }
+  }
+}
+
+// Send a probe and wait for it, so that everything sent before it has been dealt with, then
+// close the reader's input and wait for it to exit. Its input is an anonymous pipe, which can't
+// have another writer, so it exits at the end of it.
+static void finish_reader(Reader *r, struct rusage *usage) {
+  pump(r, probe_item, sizeof(probe_item) - 1, 1);
+  close(r->to_reader); // the reader exits at the end of its input
+  while (drain(r) >= 0)
+    ;
+  close(r->from_reader);
+  int status;
+  if (wait4(r->pid, &status, 0, usage) < 0)
+    die("could not wait for the reader: %s", strerror(errno));
+  if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    die("the reader failed, with status 0x%x", status);
+}
+
+static int compare_uint64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void usage(const char *progname) {
+  fprintf(stderr,
+          "Usage: %s [--name NAME] [--latency-items N] STREAM READER [READER-OPTIONS...]\n"
+          "Pipes the metadata stream in the file STREAM through the reader program and reports\n"
+          "its throughput, per-item latency for the first N items (default 5000) and peak RSS.\n",
+          progname);
+}
+
+int main(int argc, char *argv[]) {
+  debug_init(0, 0, 1, 1);
+  signal(SIGPIPE, SIG_IGN);
+  const char *name = NULL;
+  size_t latency_items = 5000;
+  int i = 1;
+  while ((i < argc) && (strncmp(argv[i], "--", 2) == 0)) {
+    if ((strcmp(argv[i], "--name") == 0) && (i + 1 < argc)) {
+      name = argv[++i];
+    } else if ((strcmp(argv[i], "--latency-items") == 0) && (i + 1 < argc)) {
+      latency_items = strtoul(argv[++i], NULL, 10);
+    } else {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    i++;
+  }
+  if (argc - i < 2) {
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  const char *stream_name = argv[i];
+  char **reader_argv = &argv[i + 1];
+  if (name == NULL)
+    name = stream_name;
+
+  int fd = open(stream_name, O_RDONLY);
+  struct stat st;
+  if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size == 0))
+    die("could not open the stream \"%s\": %s", stream_name, strerror(errno));
+  size_t stream_length = st.st_size;
+  const char *stream = mmap(NULL, stream_length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (stream == MAP_FAILED)
+    die("could not map the stream \"%s\": %s", stream_name, strerror(errno));
+  close(fd);
+
+  // find where each item starts
+  size_t item_count = 0, item_capacity = 4096;
+  size_t *item_starts = malloc(item_capacity * sizeof(size_t));
+  const char *p = stream;
+  while ((p = memmem(p, stream_length - (p - stream), "<item>", 6)) != NULL) {
+    if (item_count == item_capacity) {
+      item_capacity *= 2;
+      item_starts = realloc(item_starts, item_capacity * sizeof(size_t));
+    }
+    if (item_starts == NULL)
+      die("could not allocate the item index");
+    item_starts[item_count++] = p - stream;
+    p += 6;
+  }
+  if (item_count == 0)
+    die("there are no items in the stream \"%s\"", stream_name);
+
+  // throughput
+  Reader r;
+  struct rusage ru;
+  uint64_t started = bench_now_ns();
+  start_reader(&r, reader_argv);
+  pump(&r, stream, stream_length, 0);
+  finish_reader(&r, &ru);
+  double seconds = (bench_now_ns() - started) / 1e9;
+  uint64_t output_bytes = r.output_bytes;
+
+  // latency
+  if (latency_items > item_count)
+    latency_items = item_count;
+  uint64_t *latencies = malloc((latency_items ? latency_items : 1) * sizeof(uint64_t));
+  if (latencies == NULL)
+    die("could not allocate the latency samples");
+  start_reader(&r, reader_argv);
+  size_t k;
+  for (k = 0; k < latency_items; k++) {
+    size_t end = k + 1 < item_count ? item_starts[k + 1] : stream_length;
+    uint64_t sent = bench_now_ns();
+    pump(&r, stream + item_starts[k], end - item_starts[k], 0);
+    pump(&r, probe_item, sizeof(probe_item) - 1, 1);
+    latencies[k] = bench_now_ns() - sent;
+  }
+  finish_reader(&r, NULL);
+  qsort(latencies, latency_items, sizeof(uint64_t), compare_uint64);
+
+  printf("%s: %zu items, %.1f MB in %.3f s: %.0f items/s, %.1f MB/s, %.1f MB out, peak RSS %ld KB\n",
+         name, item_count, stream_length / 1e6, seconds, item_count / seconds,
+         stream_length / 1e6 / seconds, output_bytes / 1e6, ru.ru_maxrss);
+  if (latency_items)
+    printf("%s: latency over %zu items: p50 %.1f us, p99 %.1f us, max %.1f us\n", name,
+           latency_items, latencies[latency_items / 2] / 1e3,
+           latencies[(latency_items * 99) / 100] / 1e3, latencies[latency_items - 1] / 1e3);
+  free(latencies);
+  free(item_starts);
+  munmap((void *)stream, stream_length);
+  return 0;
+}
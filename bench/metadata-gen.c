@@ -0,0 +1,321 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Writes a synthetic Shairport Sync metadata stream to stdout, for the benchmarks.
+//
+// The stream is made up of units, picked at random according to the weights in the mix:
+//   text   -- a metadata bundle: mdst, a set of core text and number tags, mden
+//   flood  -- a phbt or prgr item, as sent many times a second during play
+//   pict   -- artwork: pcst, a PICT item of --pict-size bytes, pcen
+//   copl   -- an ssnc/copl command message binary plist
+// until at least --items items have been written.
+//
+// With --udp, the items are sent as datagrams to a UDP port instead, the way Shairport Sync
+// sends them to its metadata socket -- see utilities/udp-source.h. Items too big for a datagram
+// of --msglength bytes are sent in chunks.
+
+#include "bench-common.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { UNIT_TEXT, UNIT_FLOOD, UNIT_PICT, UNIT_COPL, UNIT_KINDS };
+static const char *unit_names[UNIT_KINDS] = {"text", "flood", "pict", "copl"};
+
+static char *encode_buffer = NULL;
+static size_t encode_buffer_size = 0;
+static uint64_t items_written = 0;
+
+static int udp_fd = -1;
+static size_t udp_msglength = 500;
+
+static void send_datagram(const void *datagram, size_t length) {
+  static uint64_t datagrams_sent = 0;
+  while (send(udp_fd, datagram, length, 0) < 0) {
+    if ((errno != ENOBUFS) && (errno != ECONNREFUSED) && (errno != EINTR))
+      die("could not send a datagram: %s", strerror(errno));
+  }
+  // give the receiver a moment now and again, so a burst doesn't overflow its socket buffer
+  if ((++datagrams_sent % 64) == 0) {
+    struct timespec pause = {0, 200000};
+    nanosleep(&pause, NULL);
+  }
+}
+
+static void put_uint32(unsigned char *p, uint32_t v) {
+  v = htonl(v);
+  memcpy(p, &v, sizeof(v));
+}
+
+static void send_item(uint32_t type, uint32_t code, const void *data, size_t length) {
+  unsigned char datagram[65536];
+  if (8 + length <= udp_msglength) {
+    put_uint32(datagram, type);
+    put_uint32(datagram + 4, code);
+    memcpy(datagram + 8, data, length);
+    send_datagram(datagram, 8 + length);
+    return;
+  }
+  size_t chunk_length = udp_msglength - 24;
+  uint32_t chunks = (length + chunk_length - 1) / chunk_length;
+  for (uint32_t i = 0; i < chunks; i++) {
+    size_t n = i + 1 < chunks ? chunk_length : length - i * chunk_length;
+    put_uint32(datagram, 'ssnc');
+    put_uint32(datagram + 4, 'chnk');
+    put_uint32(datagram + 8, i);
+    put_uint32(datagram + 12, chunks);
+    put_uint32(datagram + 16, type);
+    put_uint32(datagram + 20, code);
+    memcpy(datagram + 24, (const char *)data + i * chunk_length, n);
+    send_datagram(datagram, 24 + n);
+  }
+}
+
+static void open_udp(const char *address) {
+  char *copy = strdup(address);
+  char *colon = strrchr(copy, ':');
+  if (colon == NULL)
+    die("the UDP address must be HOST:PORT");
+  *colon = '\0';
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM};
+  struct addrinfo *ai;
+  int r = getaddrinfo(copy, colon + 1, &hints, &ai);
+  if (r != 0)
+    die("can't use the address \"%s\": %s", address, gai_strerror(r));
+  udp_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+  if ((udp_fd < 0) || (connect(udp_fd, ai->ai_addr, ai->ai_addrlen) != 0))
+    die("could not open a UDP socket to \"%s\": %s", address, strerror(errno));
+  freeaddrinfo(ai);
+  free(copy);
+}
+
+static void write_item(uint32_t type, uint32_t code, const void *data, size_t length) {
+  if (udp_fd >= 0) {
+    send_item(type, code, data, length);
+    items_written++;
+    return;
+  }
+  printf("<item><type>%08x</type><code>%08x</code><length>%zu</length>", type, code, length);
+  if (length) {
+    if (BENCH_BASE64_LENGTH(length) > encode_buffer_size) {
+      encode_buffer_size = BENCH_BASE64_LENGTH(length);
+      encode_buffer = realloc(encode_buffer, encode_buffer_size);
+      if (encode_buffer == NULL)
+        die("could not allocate %zu bytes for encoding", encode_buffer_size);
+    }
+    size_t n = bench_base64_encode(data, length, encode_buffer);
+    fputs("\n<data encoding=\"base64\">\n", stdout);
+    fwrite(encode_buffer, 1, n, stdout);
+    fputs("</data>", stdout);
+  }
+  fputs("</item>\n", stdout);
+  items_written++;
+}
+
+static void write_string_item(uint32_t type, uint32_t code, const char *s) {
+  write_item(type, code, s, strlen(s));
+}
+
+static void write_uint32_item(uint32_t type, uint32_t code, uint32_t v) {
+  unsigned char b[4] = {v >> 24, v >> 16, v >> 8, v};
+  write_item(type, code, b, sizeof(b));
+}
+
+static void words(BenchRng *rng, char *s, size_t size) {
+  static const char *vocabulary[] = {"Stabat", "Mater", "Dolorosa", "Concerto", "in", "D",
+                                     "Minor", "Live", "at", "the", "Café", "Nocturne", "Remix",
+                                     "Sonata", "Blue", "Night", "Ελληνικά", "Part", "II"};
+  size_t n = 0;
+  int count = 1 + bench_rng_below(rng, 6);
+  s[0] = '\0';
+  for (int i = 0; i < count; i++) {
+    const char *w = vocabulary[bench_rng_below(rng, sizeof(vocabulary) / sizeof(vocabulary[0]))];
+    int r = snprintf(s + n, size - n, "%s%s", i ? " " : "", w);
+    if ((r < 0) || ((size_t)r >= size - n))
+      break;
+    n += r;
+  }
+}
+
+static void write_text_unit(BenchRng *rng, uint32_t rtptime) {
+  char rtp[16], s[128];
+  snprintf(rtp, sizeof(rtp), "%u", rtptime);
+  write_string_item('ssnc', 'mdst', rtp);
+  static const uint32_t text_codes[] = {'asal', 'asar', 'minm', 'asgn', 'ascp', 'asaa'};
+  for (size_t i = 0; i < sizeof(text_codes) / sizeof(text_codes[0]); i++) {
+    words(rng, s, sizeof(s));
+    write_string_item('core', text_codes[i], s);
+  }
+  write_uint32_item('core', 'astm', 120000 + bench_rng_below(rng, 300000));
+  write_uint32_item('core', 'astn', 1 + bench_rng_below(rng, 20));
+  unsigned char persistent_id[8];
+  for (size_t i = 0; i < sizeof(persistent_id); i++)
+    persistent_id[i] = bench_rng_below(rng, 256);
+  write_item('core', 'mper', persistent_id, sizeof(persistent_id));
+  write_item('core', 'caps', "\x01", 1);
+  write_string_item('ssnc', 'mden', rtp);
+}
+
+static void write_flood_unit(BenchRng *rng, uint32_t rtptime) {
+  char s[64];
+  if (bench_rng_below(rng, 2)) {
+    snprintf(s, sizeof(s), "%u/%llu", rtptime, 5000000000ULL + (unsigned long long)rtptime * 22676);
+    write_string_item('ssnc', 'phbt', s);
+  } else {
+    snprintf(s, sizeof(s), "%u/%u/%u", rtptime - 44100, rtptime, rtptime + 44100 * 200);
+    write_string_item('ssnc', 'prgr', s);
+  }
+}
+
+static void write_pict_unit(BenchRng *rng, uint32_t rtptime, unsigned char *picture,
+                            size_t pict_size) {
+  char rtp[16];
+  snprintf(rtp, sizeof(rtp), "%u", rtptime);
+  write_string_item('ssnc', 'pcst', rtp);
+  // vary the start of the picture a little, keeping a JPEG signature
+  for (size_t i = 4; i < 64 && i < pict_size; i++)
+    picture[i] = bench_rng_below(rng, 256);
+  write_item('ssnc', 'PICT', picture, pict_size);
+  write_string_item('ssnc', 'pcen', rtp);
+}
+
+static void usage(const char *progname) {
+  fprintf(stderr,
+          "Usage: %s [--items N] [--mix text=W,flood=W,pict=W,copl=W] [--pict-size BYTES]\n"
+          "          [--seed N] [--udp HOST:PORT [--msglength BYTES]]\n"
+          "Writes a synthetic metadata stream of at least N items (default 100000) to stdout.\n"
+          "The mix gives the relative weight of each kind of unit (default\n"
+          "text=60,flood=35,pict=1,copl=4); --pict-size sets the size of the artwork (default\n"
+          "300000 bytes). With --udp, the items are sent as datagrams of at most --msglength\n"
+          "bytes (default 500) instead.\n",
+          progname);
+}
+
+static int parse_mix(const char *mix, unsigned int *weights) {
+  char *copy = strdup(mix);
+  char *saveptr = NULL;
+  int result = 0;
+  for (int i = 0; i < UNIT_KINDS; i++)
+    weights[i] = 0;
+  for (char *term = strtok_r(copy, ",", &saveptr); term; term = strtok_r(NULL, ",", &saveptr)) {
+    char *equals = strchr(term, '=');
+    int found = 0;
+    if (equals) {
+      *equals = '\0';
+      for (int i = 0; i < UNIT_KINDS; i++) {
+        if (strcmp(term, unit_names[i]) == 0) {
+          weights[i] = strtoul(equals + 1, NULL, 10);
+          found = 1;
+        }
+      }
+    }
+    if (!found)
+      result = -1;
+  }
+  free(copy);
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  debug_init(0, 0, 1, 1);
+  uint64_t items = 100000;
+  unsigned int weights[UNIT_KINDS] = {60, 35, 1, 4};
+  size_t pict_size = 300000;
+  uint64_t seed = 1;
+  int i;
+  for (i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "--items") == 0) && (i + 1 < argc)) {
+      items = strtoull(argv[++i], NULL, 10);
+    } else if ((strcmp(argv[i], "--mix") == 0) && (i + 1 < argc)) {
+      if (parse_mix(argv[++i], weights) != 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+    } else if ((strcmp(argv[i], "--pict-size") == 0) && (i + 1 < argc)) {
+      pict_size = strtoul(argv[++i], NULL, 10);
+    } else if ((strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if ((strcmp(argv[i], "--udp") == 0) && (i + 1 < argc)) {
+      open_udp(argv[++i]);
+    } else if ((strcmp(argv[i], "--msglength") == 0) && (i + 1 < argc)) {
+      udp_msglength = strtoul(argv[++i], NULL, 10);
+      if ((udp_msglength <= 24) || (udp_msglength > 65507))
+        die("the message length must be between 25 and 65507 bytes");
+    } else {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  unsigned int total_weight = 0;
+  for (i = 0; i < UNIT_KINDS; i++)
+    total_weight += weights[i];
+  if (total_weight == 0)
+    die("the mix must give some unit a weight");
+
+  BenchRng rng;
+  bench_rng_seed(&rng, seed);
+  if (pict_size < 4)
+    pict_size = 4;
+  unsigned char *picture = malloc(pict_size);
+  if (picture == NULL)
+    die("could not allocate %zu bytes for the artwork", pict_size);
+  memcpy(picture, "\xff\xd8\xff\xe0", 4);
+  for (size_t j = 4; j < pict_size; j++)
+    picture[j] = bench_rng_below(&rng, 256);
+  unsigned char copl[4096];
+  uint32_t rtptime = 0x7ff00000; // so it wraps around in longer streams
+  uint32_t seq = 0;
+
+  while (items_written < items) {
+    unsigned int pick = bench_rng_below(&rng, total_weight);
+    int unit = 0;
+    while (pick >= weights[unit])
+      pick -= weights[unit++];
+    switch (unit) {
+    case UNIT_TEXT:
+      write_text_unit(&rng, rtptime);
+      break;
+    case UNIT_FLOOD:
+      write_flood_unit(&rng, rtptime);
+      break;
+    case UNIT_PICT:
+      write_pict_unit(&rng, rtptime, picture, pict_size);
+      break;
+    case UNIT_COPL: {
+      size_t n = bench_make_copl(copl, sizeof(copl), seq++);
+      write_item('ssnc', 'copl', copl, n);
+    } break;
+    }
+    rtptime += 352 * (1 + bench_rng_below(&rng, 64));
+  }
+  free(picture);
+  free(encode_buffer);
+  return fflush(stdout) == 0 ? 0 : 1;
+}
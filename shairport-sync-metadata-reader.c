@@ -23,112 +23,376 @@ THE SOFTWARE.
 */
 
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <locale.h>
+#include <poll.h>
+#include <signal.h>
+#include "utilities/artwork.h"
+#include "utilities/base64.h"
 #include "utilities/bplist-print.h"
+#include "utilities/buffer-pool.h"
+#include "utilities/capture.h"
+#include "utilities/clock.h"
+#include "utilities/coalesce.h"
+#include "utilities/dump-file.h"
+#include "utilities/item-filter.h"
+#include "utilities/item-handlers.h"
+#include "utilities/json.h"
+#include "utilities/metadata-parser.h"
+#include "utilities/metadata-record.h"
+#include "utilities/now-playing.h"
+#include "utilities/output.h"
+#include "utilities/pipeline.h"
+#include "utilities/position.h"
+#include "utilities/sources.h"
+#include "utilities/udp-source.h"
 
 static int raw = 0; // set to 1 if you want raw output
+static int json = 0; // set to 1 for a JSON object per item
+static int exit_on_eof = 0; // set to 1 to exit when the writer closes the pipe
 
-// From Stack Overflow, with thanks:
-// http://stackoverflow.com/questions/342409/how-do-i-base64-encode-decode-in-c
-// minor mods to make independent of C99.
-// more significant changes make it not malloc memory
-// discarded base64_encode for this application
+static volatile sig_atomic_t stats_requested = 0; // set by SIGUSR1
 
-static char encoding_table[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
-                                'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
-                                'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
-                                'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
-                                '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'};
-static unsigned int decoding_table[256]; // an incoming char can range over ASCII, but by mistake
-                                         // could be all 8 bits.
+static void request_stats(__attribute__((unused)) int signum) { stats_requested = 1; }
 
-void initialise_decoding_table() {
-  int i;
-  for (i = 0; i < 64; i++)
-    decoding_table[(unsigned char)encoding_table[i]] = i;
+static void print_stats(void) {
+  BufferPoolStats stats;
+  buffer_pool_get_stats(&stats);
+  inform("buffer pool: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " releases, %" PRIu64
+         " trimmed; %zu bytes in use (peak %zu), %zu bytes cached (peak %zu).",
+         stats.hits, stats.misses, stats.releases, stats.trimmed, stats.bytes_in_use,
+         stats.peak_bytes_in_use, stats.bytes_cached, stats.peak_bytes_cached);
 }
 
-// pass in a pointer to the data, its length, a pointer to the output buffer and a pointer to an int
-// containing its maximum length the actual length will be returned.
-int base64_decode(const unsigned char *data, size_t input_length, unsigned char *decoded_data,
-                  size_t *output_length) {
-
-  // remember somewhere to call initialise_decoding_table();
+static void print_stats_if_requested(void) {
+  if (stats_requested) {
+    stats_requested = 0;
+    print_stats();
+  }
+}
 
-  if (input_length % 4 != 0)
-    return -1;
+#define PAYLOAD_NOT_DECODED 1 // the data wasn't valid base64
+#define PAYLOAD_NO_END_TAG 2  // the data wasn't followed by its closing tag
 
-  size_t calculated_output_length = input_length / 4 * 3;
-  if (data[input_length - 1] == '=')
-    calculated_output_length--;
-  if (data[input_length - 2] == '=')
-    calculated_output_length--;
-  if (calculated_output_length > *output_length)
-    return (-1);
-  *output_length = calculated_output_length;
+// Get hold of an item's payload, if any, returning it with its length in *payload_length and
+// a NUL after it. It's decoded in place, in the parser's buffer -- the decoded data is always
+// shorter than the base64 text, so there's always room for the NUL too. An item without data
+// gets no_data, a buffer of at least one byte, as its payload. Anything wrong with the data
+// is returned in *problems, as PAYLOAD_ flags.
+static char *decode_payload(MetadataItem *item, char *no_data, size_t *payload_length,
+                            int *problems) {
+  size_t outputlength = 0;
+  char *payload = no_data;
+  *problems = 0;
+  if ((item->data != NULL) && (item->flags & METADATA_ITEM_DECODED)) {
+    payload = item->data;
+    outputlength = item->data_length;
+  } else if (item->data != NULL) {
+    payload = item->data;
+    outputlength = item->length < item->data_length ? item->length : item->data_length; // max
+    if (base64_decode((unsigned char *)item->data, item->data_length, (unsigned char *)payload,
+                      &outputlength) != 0) {
+      *problems |= PAYLOAD_NOT_DECODED;
+      outputlength = 0;
+    }
+    if (item->flags & METADATA_ITEM_NO_END_TAG)
+      *problems |= PAYLOAD_NO_END_TAG;
+  }
+  payload[outputlength] = 0; // put a null on the end of the payload
+  *payload_length = outputlength;
+  return payload;
+}
 
-  size_t i, j;
-  for (i = 0, j = 0; i < input_length;) {
+// Print an item, or a junk line, to out. Returns non-zero if it ends a metadata bundle or a
+// play session. This can be called from several threads at once, in pipelined mode.
+static int print_item(FILE *out, MetadataParserStatus status, MetadataItem *item) {
+  int boundary = 0;
+  print_stats_if_requested();
+  if (status == METADATA_PARSER_ITEM) {
+    uint32_t type = item->type;
+    uint32_t code = item->code;
+    size_t length = item->length;
+    size_t outputlength;
+    char no_data[1];
+    int problems;
+    char *payload = decode_payload(item, no_data, &outputlength, &problems);
+    if (problems & PAYLOAD_NOT_DECODED)
+      fprintf(out, "Failed to decode it.\n");
+    if (problems & PAYLOAD_NO_END_TAG)
+      fprintf(out, "End data tag not seen.\n");
+    const ItemHandler *handler = item_handler_lookup(type, code);
+    if (raw != 0) {
+      default_print_payload(out, type, code, payload, outputlength, 0);
+    } else if (handler != NULL) {
+      ItemPayload p = {.data = payload, .data_length = outputlength, .length = length};
+      item_handler_print(out, handler, &p);
+    } else if ((type == 'core') || (type == 'ssnc')) {
+      default_print_payload(out, type, code, payload, outputlength, 1);
+    } else {
+      fprintf(out, "\nXXX Could not recognize: type %08" PRIx32 ", code %08" PRIx32 ".\n", type,
+              code);
+    }
+    boundary = (handler != NULL) && (handler->flags & ITEM_HANDLER_BOUNDARY);
+  } else if (status == METADATA_PARSER_JUNK) {
+    fprintf(out, "\nXXX Could not decipher: \"%.*s\".\n", (int)item->data_length, item->data);
+  }
+  return boundary;
+}
 
-    uint32_t sextet_a = data[i] == '=' ? 0 & i++ : decoding_table[data[i++]];
-    uint32_t sextet_b = data[i] == '=' ? 0 & i++ : decoding_table[data[i++]];
-    uint32_t sextet_c = data[i] == '=' ? 0 & i++ : decoding_table[data[i++]];
-    uint32_t sextet_d = data[i] == '=' ? 0 & i++ : decoding_table[data[i++]];
+// Print the payload as the members of a JSON object, according to how the handler, if any, would
+// decode it.
+static void print_json_payload(FILE *out, const ItemHandler *handler, uint32_t type,
+                               const char *payload, size_t length, size_t item_length) {
+  // the payload is decoded in place, so it may not be aligned
+  uint32_t v32, v64[2];
+  ItemDecoder decoder = handler ? handler->decoder : ITEM_DECODE_RAW;
+  if ((decoder == ITEM_DECODE_U8) && (length >= 1)) {
+    fprintf(out, ",\"value\":%u", (unsigned char)payload[0]);
+  } else if ((decoder == ITEM_DECODE_U32) && (length >= 4)) {
+    memcpy(&v32, payload, sizeof(uint32_t));
+    fprintf(out, ",\"value\":%" PRIu32, ntohl(v32));
+  } else if ((decoder == ITEM_DECODE_U64) && (length >= 8)) {
+    memcpy(v64, payload, sizeof(v64));
+    fprintf(out, ",\"value\":%" PRIu64, ((uint64_t)ntohl(v64[0]) << 32) | ntohl(v64[1]));
+  } else if (decoder == ITEM_DECODE_STRING) {
+    fputs(",\"value\":", out);
+    json_print_string(out, payload, length);
+  } else if (decoder == ITEM_DECODE_LENGTH) {
+    fprintf(out, ",\"length\":%zu", item_length);
+  } else if ((decoder == ITEM_DECODE_NONE) || (length == 0)) {
+    // there's nothing to show
+  } else {
+    // a plist, if it's meant to be one or if it looks like one, otherwise the bytes
+    int plist = (decoder == ITEM_DECODE_BPLIST) ||
+                ((raw == 0) && ((type == 'core') || (type == 'ssnc')) && (length > 8) &&
+                 (strncmp(payload, "bplist00", strlen("bplist00")) == 0));
+    if (plist) {
+      fputs(",\"value\":", out);
+      if (fprint_binary_plist_json(out, payload, length, 0) != EXIT_SUCCESS) {
+        fputs("null", out);
+        plist = 0;
+      }
+    }
+    if (!plist) {
+      fputs(",\"data\":", out);
+      json_print_base64(out, payload, length);
+    }
+  }
+}
 
-    uint32_t triple =
-        (sextet_a << 3 * 6) + (sextet_b << 2 * 6) + (sextet_c << 1 * 6) + (sextet_d << 0 * 6);
+// Print an item, or a junk line, to out as a JSON object on a line of its own, e.g.
+// {"type":"core","code":"minm","value":"Stabat Mater"}. Returns non-zero if it ends a metadata
+// bundle or a play session. This can be called from several threads at once, in pipelined mode.
+static int print_json_item(FILE *out, MetadataParserStatus status, MetadataItem *item) {
+  print_stats_if_requested();
+  if (status == METADATA_PARSER_JUNK) {
+    size_t length = item->data_length;
+    while ((length > 0) && ((item->data[length - 1] == '\n') || (item->data[length - 1] == '\r')))
+      length--;
+    fputs("{\"junk\":", out);
+    json_print_string(out, item->data, length);
+    fputs("}\n", out);
+    return 0;
+  }
+  if (status != METADATA_PARSER_ITEM)
+    return 0;
+  size_t length;
+  char no_data[1];
+  int problems;
+  char *payload = decode_payload(item, no_data, &length, &problems);
+  const ItemHandler *handler = raw ? NULL : item_handler_lookup(item->type, item->code);
+  fputs("{\"type\":", out);
+  json_print_fourcc(out, item->type);
+  fputs(",\"code\":", out);
+  json_print_fourcc(out, item->code);
+  if (problems & PAYLOAD_NOT_DECODED)
+    fputs(",\"error\":\"the data is not valid base64\"", out);
+  if (problems & PAYLOAD_NO_END_TAG)
+    fputs(",\"no_end_tag\":true", out);
+  print_json_payload(out, handler, item->type, payload, length, item->length);
+  if (handler && (item->type == 'ssnc') && (item->code == 'PICT') && artwork_enabled() &&
+      (length > 0)) {
+    char path[PATH_MAX];
+    if (artwork_save(payload, length, path, sizeof(path)) >= 0) {
+      fputs(",\"file\":", out);
+      json_print_string(out, path, strlen(path));
+    }
+  }
+  fputs("}\n", out);
+  return (handler != NULL) && (handler->flags & ITEM_HANDLER_BOUNDARY);
+}
 
-    if (j < *output_length)
-      decoded_data[j++] = (triple >> 2 * 8) & 0xFF;
-    if (j < *output_length)
-      decoded_data[j++] = (triple >> 1 * 8) & 0xFF;
-    if (j < *output_length)
-      decoded_data[j++] = (triple >> 0 * 8) & 0xFF;
+// Write an item, or a junk line, to out as a binary record -- see metadata-record.h. Returns
+// non-zero if it ends a metadata bundle or a play session.
+static int print_binary_item(FILE *out, MetadataParserStatus status, MetadataItem *item) {
+  print_stats_if_requested();
+  MetadataRecordHeader header = {.sequence = item->sequence, .received_ns = item->received_ns};
+  const ItemHandler *handler = NULL;
+  const char *payload;
+  size_t length;
+  if (status == METADATA_PARSER_JUNK) {
+    header.flags = METADATA_RECORD_JUNK;
+    payload = item->data;
+    length = item->data_length;
+  } else if (status == METADATA_PARSER_ITEM) {
+    char no_data[1];
+    int problems;
+    payload = decode_payload(item, no_data, &length, &problems);
+    header.type = item->type;
+    header.code = item->code;
+    if (problems & PAYLOAD_NOT_DECODED)
+      header.flags |= METADATA_RECORD_NOT_DECODED;
+    if (problems & PAYLOAD_NO_END_TAG)
+      header.flags |= METADATA_RECORD_NO_END_TAG;
+    handler = item_handler_lookup(item->type, item->code);
+  } else {
+    return 0;
+  }
+  if (length > UINT32_MAX) {
+    header.flags |= METADATA_RECORD_TRUNCATED;
+    length = 0;
   }
+  header.payload_length = length;
+  metadata_record_write(out, &header, payload);
+  return (handler != NULL) && (handler->flags & ITEM_HANDLER_BOUNDARY);
+}
 
-  return 0;
+static uint64_t position_interval_ns = 0; // with --position, how often to print the position
+static uint64_t position_due_ns = 0;
+static uint64_t position_printed_ms = UINT64_MAX;
+
+// Print the playback position if it's time to and it has moved on. Returns 1 if it's printed.
+static int print_position_if_due(FILE *out, uint64_t now) {
+  if ((position_interval_ns == 0) || (now < position_due_ns))
+    return 0;
+  position_due_ns = now + position_interval_ns;
+  PlaybackPosition position;
+  if (!position_get(now, &position) || (position.position_ms == position_printed_ms))
+    return 0;
+  now_playing_print_position(out, &position);
+  position_printed_ms = position.position_ms;
+  return 1;
 }
 
-void default_print_payload(uint32_t type, uint32_t code, const char *payload, const size_t length) {
-  char typestring[5];
-  *(uint32_t *)typestring = htonl(type);
-  typestring[4] = 0;
-  char codestring[5];
-  *(uint32_t *)codestring = htonl(code);
-  codestring[4] = 0;
-  if (length > 0) {
+// Instead of printing the items, keep track of what's playing, printing the changes.
+static int print_now_playing(FILE *out, MetadataParserStatus status, MetadataItem *item) {
+  print_stats_if_requested();
+  if (status != METADATA_PARSER_ITEM)
+    return 0;
+  size_t length;
+  char no_data[1];
+  int problems;
+  char *payload = decode_payload(item, no_data, &length, &problems);
+  position_update(item->type, item->code, payload, length, item->received_ns);
+  int boundary = now_playing_update(out, item->type, item->code, payload, length);
+  return print_position_if_due(out, monotonic_ns()) | boundary;
+}
 
-    // try to interpret plists in the feed if we have pretty printing and we're not asking for raw
-    if ((raw == 0) && (length > strlen("bplist00")) && (strncmp(payload, "bplist00", strlen("bplist00")) == 0)) {
-      printf("\"%s\" \"%s\":\n", typestring, codestring);
-      pretty_print_binary_plist(payload, length, 1);
-    } else {
-      size_t buffer_length = 128; // item size is two bytes
-      char obf[buffer_length * 2 + 1];
-      char *obfp = obf;
-      size_t obfc;
-      for (obfc = 0; ((obfc < length) && (obfc < buffer_length)); obfc++) {
-        snprintf(obfp, 3, "%02X", payload[obfc]);
-        obfp += 2;
-      };
-      *obfp = 0;
-      if (length > buffer_length)
-        printf("\"%s\" \"%s\": 0x%s... (%zu bytes in payload)\n", typestring, codestring, obf,
-               length);
-      else
-        printf("\"%s\" \"%s\": 0x%s\n", typestring, codestring, obf);
+// The parser's before_read hook with --position: while there's no input, keep printing the
+// position when it's due, working it out from the last position the player sent.
+static void wait_for_input_printing_position(int fd) {
+  output_wait_for_input(fd);
+  while (1) {
+    uint64_t now = monotonic_ns();
+    if (print_position_if_due(stdout, now)) {
+      output_item_done(1);
+      now = monotonic_ns();
     }
-  } else {
-    printf("\"%s\" \"%s\"\n", typestring, codestring);
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    int timeout_ms = position_due_ns > now ? (int)((position_due_ns - now + 999999) / 1000000) : 0;
+    if (poll(&pfd, 1, timeout_ms) != 0)
+      return; // input has arrived, or a signal
+  }
+}
+
+// At the end of the input, wait for a writer to open the pipe again. Returns 1 when there's one,
+// or 0 if there won't be -- if asked to exit at EOF, or if the input isn't a named pipe.
+static int wait_for_writer(MetadataParser *parser) {
+  struct stat st;
+  char link[64];
+  ssize_t n;
+  if (exit_on_eof || (fstat(STDIN_FILENO, &st) != 0) || !S_ISFIFO(st.st_mode))
+    return 0;
+  // an unnamed pipe, e.g. from a shell pipeline, has no name to be opened by again
+  n = readlink("/proc/self/fd/0", link, sizeof(link) - 1);
+  if ((n > 0) && (strncmp(link, "pipe:", strlen("pipe:")) == 0))
+    return 0;
+  // Reopening the pipe waits, without using the CPU, until a writer opens it. (Until then, reads
+  // of the old one would return EOF straight away, again and again.)
+  int fd;
+  while ((fd = open("/proc/self/fd/0", O_RDONLY | O_CLOEXEC)) < 0) {
+    if (errno != EINTR)
+      die("could not reopen the metadata pipe: %s", strerror(errno));
+    print_stats_if_requested();
   }
+  if (dup2(fd, STDIN_FILENO) < 0)
+    die("could not reopen the metadata pipe: %s", strerror(errno));
+  close(fd);
+  metadata_parser_reset(parser);
+  return 1;
+}
+
+static void usage(const char *progname) {
+  fprintf(stderr,
+          "Usage: %s [OPTIONS] [--binary | --now-playing] [--threads N] [--exit-on-eof]\n"
+          "          < /tmp/shairport-sync-metadata\n"
+          "       %s [OPTIONS] [--exit-on-eof] [NAME=]PIPE...\n"
+          "       %s [OPTIONS] [--binary | --now-playing] --udp [HOST:]PORT\n"
+          "       %s [OPTIONS] [--binary | --now-playing] [--threads N] --replay FILE\n"
+          "          [--realtime] [--start SECONDS]\n"
+          "       %s [OPTIONS] [--threads N] [--unordered] --file FILE\n"
+          "The OPTIONS are --raw, --json, --unbuffered, --only, --skip and --artwork:\n"
+          "  --raw         print the metadata items without interpreting them.\n"
+          "  --json        print each item, or each --now-playing record, as a JSON object on a\n"
+          "                line of its own.\n"
+          "  --unbuffered  flush the output after every item.\n"
+          "  --coalesce    if the output isn't being read fast enough, keep only the latest\n"
+          "                output of items like phbt, prgr, pvol and the track fields, rather\n"
+          "                than holding up the player. Only for the first or fourth forms,\n"
+          "                without --threads, --binary or --now-playing.\n"
+          "  --only LIST   print only the items listed, e.g. core,ssnc/pvol -- a comma-separated\n"
+          "                list of TYPE or TYPE/CODE entries. It can be given more than once.\n"
+          "  --skip LIST   don't print the items listed, e.g. ssnc/PICT,ssnc/phbt. Unwanted items\n"
+          "                are skipped over without being decoded.\n"
+          "  --artwork DIR save pictures to DIR, named by a hash of their contents, with a link\n"
+          "                called \"current\" to the latest one.\n"
+          "  --now-playing instead of the items, print what's playing -- a line with the fields\n"
+          "                that have changed whenever a metadata bundle ends or a player\n"
+          "                setting, like the volume, changes. Not with --threads.\n"
+          "  --position MS with --now-playing, print the playback position every MS\n"
+          "                milliseconds while it's changing, even between items.\n"
+          "  --binary      write each item as a binary record, as defined in\n"
+          "                utilities/metadata-record.h, instead of printing it.\n"
+          "  --threads N   read, decode and print items in a pipeline, with N decoding threads.\n"
+          "  --exit-on-eof exit when the writer closes the pipe, rather than waiting for it to\n"
+          "                be opened again.\n"
+          "  --record FILE save everything read, and when it arrived, to FILE, to be replayed\n"
+          "                later. Not with the second or third forms.\n"
+          "  --replay FILE read the metadata from a file saved by --record, as fast as possible,\n"
+          "                and report how long it took on stderr.\n"
+          "  --realtime    replay it at the pace it was recorded at.\n"
+          "  --start SECONDS  start the replay SECONDS into the recording.\n"
+          "  --unordered   write the output of each part of the --file as soon as it's done,\n"
+          "                rather than in the original order.\n"
+          "The second form reads from one or more metadata pipes, tagging every line of output\n"
+          "with the name of the pipe it came from. The third receives metadata sent by\n"
+          "Shairport Sync to a UDP port. The fourth replays a recording made with --record.\n"
+          "The fifth processes a saved metadata file, which can be very large, in parts, in\n"
+          "parallel on N threads -- by default, one for each CPU. Not with --binary or\n"
+          "--now-playing.\n",
+          progname, progname, progname, progname, progname);
 }
 
 int main(int argc, char *argv[]) {
@@ -136,232 +400,165 @@ int main(int argc, char *argv[]) {
   // initialise debug messages stuff
   // debug_init(int level, int show_elapsed_time, int show_relative_time, int show_file_and_line)
   debug_init(0, 0, 1, 1);
-  initialise_decoding_table();
-  if ((argc == 2) && (strcmp(argv[1], "--raw") == 0)) {
-          raw = 1;
+  base64_init();
+  item_handlers_init();
+  int unbuffered = 0;
+  int workers = 0; // if non-zero, the number of decoding threads in pipelined mode
+  char **sources = malloc(argc * sizeof(char *)); // metadata pipes to read instead of stdin
+  int source_count = 0;
+  const char *udp_address = NULL; // [HOST:]PORT to receive metadata on instead
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+  int realtime = 0;
+  const char *dump_path = NULL;
+  int unordered = 0;
+  int position_ms = 0;
+  int coalesce = 0;
+  double start_seconds = 0;
+  ItemFormatFunction format = print_item;
+  int i;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--raw") == 0) {
+      raw = 1;
+    } else if (strcmp(argv[i], "--unbuffered") == 0) {
+      unbuffered = 1;
+    } else if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc)) {
+      workers = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else if (strcmp(argv[i], "--binary") == 0) {
+      format = print_binary_item;
+    } else if (strcmp(argv[i], "--now-playing") == 0) {
+      format = print_now_playing;
+    } else if ((strcmp(argv[i], "--artwork") == 0) && (i + 1 < argc)) {
+      artwork_init(argv[++i]);
+    } else if ((strcmp(argv[i], "--only") == 0) && (i + 1 < argc)) {
+      item_filter_add(argv[++i], 1);
+    } else if ((strcmp(argv[i], "--skip") == 0) && (i + 1 < argc)) {
+      item_filter_add(argv[++i], 0);
+    } else if (strcmp(argv[i], "--exit-on-eof") == 0) {
+      exit_on_eof = 1;
+    } else if ((strcmp(argv[i], "--udp") == 0) && (i + 1 < argc)) {
+      udp_address = argv[++i];
+    } else if ((strcmp(argv[i], "--record") == 0) && (i + 1 < argc)) {
+      record_path = argv[++i];
+    } else if ((strcmp(argv[i], "--replay") == 0) && (i + 1 < argc)) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--realtime") == 0) {
+      realtime = 1;
+    } else if ((strcmp(argv[i], "--start") == 0) && (i + 1 < argc)) {
+      start_seconds = atof(argv[++i]);
+    } else if ((strcmp(argv[i], "--file") == 0) && (i + 1 < argc)) {
+      dump_path = argv[++i];
+    } else if (strcmp(argv[i], "--unordered") == 0) {
+      unordered = 1;
+    } else if (strcmp(argv[i], "--coalesce") == 0) {
+      coalesce = 1;
+    } else if ((strcmp(argv[i], "--position") == 0) && (i + 1 < argc)) {
+      position_ms = atoi(argv[++i]);
+    } else if (strncmp(argv[i], "--", 2) != 0) {
+      sources[source_count++] = argv[i];
+    } else {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  // the now-playing state is of a single stream, and has to be fed its items in order, and
+  // binary records can't be tagged with the name of the pipe they came from. Recording and
+  // replaying are only of standard input. The parts of a --file are processed in parallel, so
+  // the output can't depend on the order the items are seen in.
+  if ((((source_count > 0) + (workers > 0) + (udp_address != NULL)) > 1) ||
+      ((format == print_now_playing) && ((source_count > 0) || (workers > 0))) ||
+      ((format == print_binary_item) && ((source_count > 0) || json)) ||
+      ((record_path || replay_path) && ((source_count > 0) || udp_address)) ||
+      ((realtime || (start_seconds != 0)) && (replay_path == NULL)) ||
+      (dump_path && ((source_count > 0) || udp_address || record_path || replay_path ||
+                     (format == print_now_playing) || (format == print_binary_item))) ||
+      (unordered && (dump_path == NULL)) ||
+      ((position_ms != 0) && ((format != print_now_playing) || udp_address || (position_ms < 0))) ||
+      (coalesce && ((source_count > 0) || udp_address || (workers > 0) || dump_path ||
+                    (format == print_binary_item) || (format == print_now_playing)))) {
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (json && (format == print_item))
+    format = print_json_item;
+  now_playing_set_json(json);
+  output_init(unbuffered, OUTPUT_DEFAULT_DEADLINE_MS);
+  if (format == print_binary_item)
+    metadata_record_write_stream_header(stdout);
+  // send SIGUSR1 to get the buffer pool statistics on stderr
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = request_stats;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR1, &sa, NULL); // no SA_RESTART, so a blocked read returns to us
+  if (source_count > 0) {
+    sources_run(sources, source_count, format,
+                (exit_on_eof ? SOURCES_EXIT_ON_EOF : 0) | (json ? SOURCES_JSON : 0));
+    free(sources);
+    return 0;
+  }
+  if (udp_address)
+    udp_source_run(udp_address, format); // doesn't return
+  free(sources);
+  if (dump_path) {
+    dump_file_run(dump_path, workers, format, unordered ? DUMP_FILE_UNORDERED : 0);
+    return 0;
+  }
+  if (replay_path) {
+    capture_replay_start(replay_path, realtime, start_seconds); // standard input is now a pipe
+    exit_on_eof = 1;
+  }
+  MetadataParser parser;
+  metadata_parser_init(&parser, STDIN_FILENO);
+  if (record_path) {
+    capture_record_open(record_path);
+    parser.after_item = capture_record_item;
+  }
+  if (workers > 0) {
+    pipeline_run(&parser, workers, format, wait_for_writer);
+    capture_record_close();
+    capture_replay_finish();
+    metadata_parser_free(&parser);
+    return 0;
+  }
+  parser.before_read = output_wait_for_input;
+  // each item's output is queued, to be coalesced if need be, rather than going into stdout
+  int coalescing = coalesce && coalesce_init();
+  if (coalescing)
+    parser.before_read = coalesce_wait_for_input;
+  if (position_ms > 0) {
+    position_interval_ns = (uint64_t)position_ms * 1000000;
+    parser.before_read = wait_for_input_printing_position;
   }
   while (1) {
-    char str[1025];
-    char alt[1025];
-    if (fgets(str, 1024, stdin)) {
-      uint32_t type, code;
-      size_t length;
-      int ret = sscanf(str, "<item><type>%8x</type><code>%8x</code><length>%zu</length>", &type,
-                       &code, &length);
-      if (ret == 3) {
-
-        // now, think about processing the tag.
-        // basically, we need to get hold of the base-64 data, if any
-        size_t outputlength = 0;
-        char *payload = malloc(length + 1);
-        if (length > 0) {
-
-          fgets(alt, 1024, stdin);
-          if (strcmp(alt, "<data encoding=\"base64\">\n") == 0) {
-            /*
-            // get the next line, which should be a data tag
-            int rc = fscanf(stdin, "<data encoding=\"base64\">");
-            if (rc == 0) {
-              // now, read in that big (possibly) base64 buffer
-              int c = fgetc(stdin); // skip the newline
-            */
-
-            uint32_t b64size = 4 * ((length + 2) / 3);
-            void *b64buf = malloc(b64size + 1);
-            if (b64buf) {
-              // this reads b64size bytes only
-              if (fgets(b64buf, b64size + 1, stdin) != NULL) {
-                // it looks like we got it
-                outputlength = length; // max size
-                if (base64_decode(b64buf, b64size, (unsigned char *)payload, &outputlength) != 0) {
-                  printf("Failed to decode it.\n");
-                }
-              }
-              free(b64buf);
-            } else {
-              printf("couldn't allocate memory for base-64 stuff\n");
-            }
-            fgets(str, 1024, stdin);
-            if (strcmp(str, "</data></item>\n") != 0)
-              printf("End data tag not seen, \"%s\" seen instead.\n", str);
-            // now, there will either be a line feed or nothing at the end of this line
-            // it's not necessary XML, but it's what Shairport Sync puts out, and it makes life a
-            // bit easier So, if there's something there and it's not just a linefeed, it's an error
-            // if ((fgets(str, 1024, stdin) != NULL) && ((strlen(str) != 1) || (str[0] != 0x0A)))
-            //  printf("Error -- unexpected characters at the end of a base64 section.\n");
-          }
-        }
-        payload[outputlength] = 0; // put a null on the end of the payload
-        if (raw != 0) {
-          default_print_payload(type, code, payload, outputlength);
-        } else if (type == 'core') {
-          // this has more information about tags, which might be relevant:
-          // https://code.google.com/p/ytrack/wiki/DMAP
-          switch (code) {
-          case 'mper': {
-            // get the 64-bit number as a uint64_t by reading two uint32_t s and combining them
-            uint64_t vl = ntohl(*(uint32_t *)payload); // get the high order 32 bits
-            vl = vl << 32;                             // shift them into the correct location
-            uint64_t ul =
-                ntohl(*(uint32_t *)(payload + sizeof(uint32_t))); // and the low order 32 bits
-            vl = vl + ul;
-            printf("Persistent ID: 0x%" PRIx64 ".\n", vl);
-
-          } break;
-          case 'astm': {
-            uint32_t tracklength = ntohl(*(uint32_t *)payload);
-            printf("Track length: %" PRIu32 " milliseconds.\n", tracklength);
-          } break;
-          case 'asul':
-            printf("URL: \"%s\".\n", payload);
-            break;
-          case 'asal':
-            printf("Album Name: \"%s\".\n", payload);
-            break;
-          case 'asar':
-            printf("Artist: \"%s\".\n", payload);
-            break;
-          case 'ascm':
-            printf("Comment: \"%s\".\n", payload);
-            break;
-          case 'asgn':
-            printf("Genre: \"%s\".\n", payload);
-            break;
-          case 'minm':
-            printf("Title: \"%s\".\n", payload);
-            break;
-          case 'ascp':
-            printf("Composer: \"%s\".\n", payload);
-            break;
-          case 'asdt':
-            printf("File kind: \"%s\".\n", payload);
-            break;
-          case 'asdk':
-            printf("Song Data Kind (\"asdk\"): (possibly 0 == timed track, 1 == untimed stream): "
-                   "\"%u\".\n",
-                   payload[0]);
-            break;
-          case 'assn':
-            printf("Sort as: \"%s\".\n", payload);
-            break;
-          default:
-            default_print_payload(type, code, payload, outputlength);
-            break;
-          }
-        } else if (type == 'ssnc') {
-          switch (code) {
-          case 'PICT':
-            printf("Picture received, length %zu bytes.\n", length);
-            break;
-          case 'clip':
-            printf("The AirPlay client at \"%s\" has connected to this player.\n", payload);
-            break;
-          case 'pvol':
-            printf("Volume: \"%s\".\n", payload);
-            break;
-          case 'pcst':
-            printf("Picture \"%s\" start.\n", payload);
-            break;
-          case 'pcen':
-            printf("Picture \"%s\" end.\n", payload);
-            break;
-          case 'mdst':
-            printf("Metadata bundle \"%s\" start.\n", payload);
-            break;
-          case 'mden':
-            printf("Metadata bundle \"%s\" end.\n", payload);
-            break;
-          case 'snam':
-            printf("The name of the AirPlay client is \"%s\".\n", payload);
-            break;
-          case 'cmod':
-            printf("The model of the AirPlay client is \"%s\".\n", payload);
-            break;
-          case 'svip':
-            printf("The address used by this player for this play session is: \"%s\".\n", payload);
-            break;
-          case 'svna':
-            printf("The service name of this player is: \"%s\".\n", payload);
-            break;
-          case 'conn':
-            printf("The AirPlay client at \"%s\" is about to connect to this player. (AirPlay 2 "
-                   "only.)\n",
-                   payload);
-            break;
-          case 'disc':
-            printf("The AirPlay client at \"%s\" has disconnected from this player. (AirPlay 2 "
-                   "only.)\n",
-                   payload);
-            break;
-          case 'cdid':
-            printf("The AirPlay client's Device ID is \"%s\". (AirPlay 2 only.)\n", payload);
-            break;
-          case 'cmac':
-            printf("The AirPlay client's MAC address is \"%s\". (AirPlay 2 only.)\n", payload);
-            break;
-          case 'prgr':
-            printf("Progress String \"%s\".\n", payload);
-            break;
-          case 'sdsc':
-            printf("Source Format \"%s\".\n", payload);
-            break;
-          case 'odsc':
-            printf("Output Format \"%s\".\n", payload);
-            break;
-          case 'phb0':
-            printf("First frame/time: \"%s\".\n", payload);
-            break;
-          case 'phbt':
-            printf("Playing frame/time: \"%s\".\n", payload);
-            break;
-          case 'styp':
-            printf("Stream type: \"%s\".\n", payload);
-            break;
-          case 'pffr':
-            printf("Play -- first frame received/time in ns: \"%s\".\n", payload);
-            break;
-          case 'paus':
-            printf("Pause. (AirPlay 2 only.)\n");
-            break;
-          case 'pres':
-            printf("Resume. (AirPlay 2 only.)\n");
-            break;
-          case 'prsm':
-            printf("Resume.\n");
-            break;
-          case 'pend':
-            printf("Play Session End.\n");
-            break;
-          case 'pbeg':
-            printf("Play Session Begin.\n");
-            break;
-          case 'aend':
-            printf("Exit Active State.\n");
-            break;
-          case 'abeg':
-            printf("Enter Active State.\n");
-            break;
-          case 'copl':
-            printf("COMMAND Message Plist.\n");
-            pretty_print_binary_plist(payload, length, 1);
-            break;
-          default:
-            default_print_payload(type, code, payload, outputlength);
-            break;
-          }
-        } else {
-          str[1024] = '\0';
-          printf("\nXXX Could not recognize: \"%s\".\n", str);
-        }
-        free(payload);
-        payload = NULL;
-      } else {
-        str[1024] = '\0';
-        printf("\nXXX Could not decipher: \"%s\".\n", str);
-      }
-      // flush stdout, to be able to pipe it later
-      fflush(stdout);
+    print_stats_if_requested();
+    MetadataItem item;
+    MetadataParserStatus status = metadata_parser_next(&parser, &item);
+    if (status == METADATA_PARSER_EOF) {
+      if (coalescing)
+        coalesce_flush();
+      else
+        output_flush();
+      if (wait_for_writer(&parser) == 0)
+        break;
+      continue;
+    } else if (status == METADATA_PARSER_ERROR) {
+      if (errno != EINTR)
+        die("error reading the metadata pipe: %s", strerror(errno));
+      continue;
+    }
+    if (coalescing) {
+      format(coalesce_stream(), status, &item);
+      coalesce_item_done(status, &item);
+      continue;
     }
+    // output is flushed in batches, but promptly, to be able to pipe it later
+    output_item_done(format(stdout, status, &item));
   }
+  capture_record_close();
+  capture_replay_finish();
+  metadata_parser_free(&parser);
   return 0;
 }
@@ -0,0 +1,177 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Checks that every decoder the CPU supports gives the same results as the plain C one.
+
+#include "../utilities/base64.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DATA 300
+#define GUARD 40
+#define GUARD_BYTE 0xA5
+#define ENCODED_LENGTH(len) (4 * (((len) + 2) / 3))
+
+// xorshift64*, restarted from the same seed for each decoder so they all get the same inputs
+#define RANDOM_SEED 0x9e3779b97f4a7c15
+static uint64_t random_state;
+
+static uint64_t random_next(void) {
+  uint64_t x = random_state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  random_state = x;
+  return x * 0x2545f4914f6cdd1d;
+}
+
+// Encode len bytes of in into out, padded. Returns the number of characters written.
+static size_t encode(const unsigned char *in, size_t len, char *out) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t i, o = 0;
+  for (i = 0; i + 2 < len; i += 3) {
+    uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+    out[o++] = alphabet[(v >> 18) & 0x3f];
+    out[o++] = alphabet[(v >> 12) & 0x3f];
+    out[o++] = alphabet[(v >> 6) & 0x3f];
+    out[o++] = alphabet[v & 0x3f];
+  }
+  if (i < len) {
+    uint32_t v = (uint32_t)in[i] << 16;
+    if (i + 1 < len)
+      v |= (uint32_t)in[i + 1] << 8;
+    out[o++] = alphabet[(v >> 18) & 0x3f];
+    out[o++] = alphabet[(v >> 12) & 0x3f];
+    out[o++] = i + 1 < len ? alphabet[(v >> 6) & 0x3f] : '=';
+    out[o++] = '=';
+  }
+  return o;
+}
+
+static int failures = 0;
+
+static void report(const char *what, const char *input, size_t input_length, size_t capacity) {
+  fprintf(stderr, "%s: %s differs from scalar for %zu characters \"%.*s\", capacity %zu\n",
+          base64_decoder_name(), what, input_length, (int)input_length, input, capacity);
+  failures++;
+}
+
+// Decode input with the decoder under test and the scalar one into a buffer of capacity bytes,
+// then compare the results, the lengths, and the guard bytes beyond the capacity.
+static void check(const char *input, size_t input_length, size_t capacity) {
+  unsigned char got[MAX_DATA + GUARD], want[MAX_DATA + GUARD];
+  size_t got_length = capacity, want_length = capacity;
+  memset(got, GUARD_BYTE, sizeof(got));
+  memset(want, GUARD_BYTE, sizeof(want));
+  int got_result = base64_decode((const unsigned char *)input, input_length, got, &got_length);
+  int want_result =
+      base64_decode_scalar((const unsigned char *)input, input_length, want, &want_length);
+  size_t i;
+  if (got_result != want_result)
+    report("result", input, input_length, capacity);
+  else if ((got_result == 0) &&
+           ((got_length != want_length) || (memcmp(got, want, got_length) != 0)))
+    report("output", input, input_length, capacity);
+  for (i = capacity; i < sizeof(got); i++)
+    if (got[i] != GUARD_BYTE) {
+      report("writing beyond the capacity", input, input_length, capacity);
+      break;
+    }
+}
+
+// Decode in place, as the reader does, and compare with the scalar result.
+static void check_in_place(const char *input, size_t input_length) {
+  unsigned char got[MAX_DATA * 2], want[MAX_DATA * 2];
+  size_t got_length = input_length, want_length = input_length;
+  memcpy(got, input, input_length);
+  int got_result = base64_decode(got, input_length, got, &got_length);
+  int want_result =
+      base64_decode_scalar((const unsigned char *)input, input_length, want, &want_length);
+  if ((got_result != want_result) ||
+      ((got_result == 0) && ((got_length != want_length) || (memcmp(got, want, got_length) != 0))))
+    report("in-place decoding", input, input_length, input_length);
+}
+
+static void check_all_capacities(const char *input, size_t input_length) {
+  size_t decoded = (input_length / 4) * 3 + 3;
+  size_t capacity;
+  for (capacity = decoded > 3 ? decoded - 3 : 0; capacity <= decoded + 1; capacity++)
+    check(input, input_length, capacity);
+  check(input, input_length, MAX_DATA);
+  check_in_place(input, input_length);
+}
+
+static void run_checks(void) {
+  static const char invalid[] = {'!', '-', '_', ' ', '\n', '=', '\x80', '\0'};
+  unsigned char data[MAX_DATA];
+  char encoded[ENCODED_LENGTH(MAX_DATA)], changed[ENCODED_LENGTH(MAX_DATA)];
+  size_t length, encoded_length, i;
+  random_state = RANDOM_SEED;
+  for (length = 0; length <= 200; length++) {
+    for (i = 0; i < length; i++)
+      data[i] = random_next();
+    encoded_length = encode(data, length, encoded);
+
+    // valid, padded
+    check_all_capacities(encoded, encoded_length);
+
+    // valid, with the padding left off
+    size_t unpadded = encoded_length;
+    while ((unpadded > 0) && (encoded[unpadded - 1] == '='))
+      unpadded--;
+    if (unpadded != encoded_length)
+      check_all_capacities(encoded, unpadded);
+
+    // truncated by one to three characters
+    for (i = 1; (i <= 3) && (i <= encoded_length); i++)
+      check_all_capacities(encoded, encoded_length - i);
+
+    // an invalid character at every position
+    if (encoded_length > 0)
+      for (i = 0; i < encoded_length; i++) {
+        memcpy(changed, encoded, encoded_length);
+        changed[i] = invalid[random_next() % sizeof(invalid)];
+        check(changed, encoded_length, MAX_DATA);
+        check_in_place(changed, encoded_length);
+      }
+  }
+}
+
+int main(void) {
+  static const char *decoders[] = {"avx2", "sse4.1", "scalar"};
+  size_t i;
+  base64_init();
+  for (i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++) {
+    if (base64_use_decoder(decoders[i]) != 0) {
+      printf("%s: not supported by this CPU, skipped\n", decoders[i]);
+      continue;
+    }
+    int before = failures;
+    run_checks();
+    printf("%s: %s\n", decoders[i], failures == before ? "ok" : "FAILED");
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
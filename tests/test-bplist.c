@@ -0,0 +1,472 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Checks the binary plist accessors on plists built here: lookups by key, including keys held
+// as UTF-16, by array index, and through objects shared by more than one container, both
+// straight from the buffer and in the decoded tree, whose big dicts are hash-indexed.
+// Also checks that plists beyond the decoding limits are rejected, or cut short -- the same
+// way on every path, including paths through objects shared by more than one container.
+
+#include "../utilities/bplist-print.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A minimal binary plist writer. Objects are written in order, so a container must be added
+// after everything it refers to. Object references are single bytes, so there can be at most
+// 256 objects.
+
+#define MAX_OBJECTS 256
+
+typedef struct {
+  unsigned char buf[16384];
+  size_t length;
+  uint32_t offsets[MAX_OBJECTS];
+  int count;
+} PlistWriter;
+
+static void put(PlistWriter *w, const void *p, size_t n) {
+  if (w->length + n > sizeof(w->buf)) {
+    fprintf(stderr, "the test plist is too big\n");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(w->buf + w->length, p, n);
+  w->length += n;
+}
+
+static void put_be(PlistWriter *w, uint64_t v, int size) {
+  unsigned char b[8];
+  for (int i = 0; i < size; i++)
+    b[i] = (unsigned char)(v >> (8 * (size - 1 - i)));
+  put(w, b, size);
+}
+
+static int begin_object(PlistWriter *w) {
+  if (w->count == MAX_OBJECTS) {
+    fprintf(stderr, "the test plist has too many objects\n");
+    exit(EXIT_FAILURE);
+  }
+  w->offsets[w->count] = (uint32_t)w->length;
+  return w->count++;
+}
+
+// the marker for an object of the given type and count, followed by the count if it's big
+static void put_marker(PlistWriter *w, int type, size_t count) {
+  if (count < 15) {
+    put_be(w, (type << 4) | count, 1);
+  } else {
+    put_be(w, (type << 4) | 0xf, 1);
+    put_be(w, 0x11, 1);
+    put_be(w, count, 2);
+  }
+}
+
+static int add_string(PlistWriter *w, const char *s) {
+  int ref = begin_object(w);
+  put_marker(w, 0x5, strlen(s));
+  put(w, s, strlen(s));
+  return ref;
+}
+
+// a UTF-16 string, given as UTF-16 code units
+static int add_utf16_string(PlistWriter *w, const uint16_t *s, size_t n) {
+  int ref = begin_object(w);
+  put_marker(w, 0x6, n);
+  for (size_t i = 0; i < n; i++)
+    put_be(w, s[i], 2);
+  return ref;
+}
+
+static int add_int(PlistWriter *w, int64_t v) {
+  int ref = begin_object(w);
+  put_be(w, 0x13, 1);
+  put_be(w, (uint64_t)v, 8);
+  return ref;
+}
+
+static int add_array(PlistWriter *w, int n, const int *items) {
+  int ref = begin_object(w);
+  put_marker(w, 0xa, n);
+  for (int i = 0; i < n; i++)
+    put_be(w, items[i], 1);
+  return ref;
+}
+
+static int add_dict(PlistWriter *w, int n, const int *keys, const int *values) {
+  int ref = begin_object(w);
+  put_marker(w, 0xd, n);
+  for (int i = 0; i < n; i++)
+    put_be(w, keys[i], 1);
+  for (int i = 0; i < n; i++)
+    put_be(w, values[i], 1);
+  return ref;
+}
+
+static void finish(PlistWriter *w, int top) {
+  size_t offset_table = w->length;
+  for (int i = 0; i < w->count; i++)
+    put_be(w, w->offsets[i], 4);
+  put_be(w, 0, 6); // unused
+  put_be(w, 4, 1); // offset size
+  put_be(w, 1, 1); // object reference size
+  put_be(w, w->count, 8);
+  put_be(w, top, 8);
+  put_be(w, offset_table, 8);
+}
+
+// The plist the tests use:
+// {
+//   "type": "updateNowPlaying",
+//   "params": { "title": "Song", "café" (a UTF-16 key): 7 },
+//   "list": [ "zero", <params>, 42 ],
+//   "alias": <params>
+// }
+// where <params> is the same object each time.
+static void make_plist(PlistWriter *w) {
+  static const uint16_t cafe[] = {'c', 'a', 'f', 0xe9};
+  memset(w, 0, sizeof(PlistWriter));
+  put(w, "bplist00", 8);
+  int keys[4], values[4], items[3];
+  keys[0] = add_string(w, "title");
+  values[0] = add_string(w, "Song");
+  keys[1] = add_utf16_string(w, cafe, sizeof(cafe) / sizeof(cafe[0]));
+  values[1] = add_int(w, 7);
+  int params = add_dict(w, 2, keys, values);
+  items[0] = add_string(w, "zero");
+  items[1] = params;
+  items[2] = add_int(w, 42);
+  keys[0] = add_string(w, "type");
+  values[0] = add_string(w, "updateNowPlaying");
+  keys[1] = add_string(w, "params");
+  values[1] = params;
+  keys[2] = add_string(w, "list");
+  values[2] = add_array(w, 3, items);
+  keys[3] = add_string(w, "alias");
+  values[3] = params;
+  finish(w, add_dict(w, 4, keys, values));
+}
+
+static int failures = 0;
+
+static void fail(const char *what, const char *path) {
+  fprintf(stderr, "\"%s\": %s\n", path, what);
+  failures++;
+}
+
+static void expect_missing(const BplistCtx *ctx, const char *path) {
+  BplistValue v;
+  if (bplist_lookup(ctx, path, &v) == 0)
+    fail("found, but it isn't there", path);
+}
+
+static void expect_string(const BplistCtx *ctx, const char *path, const char *s) {
+  BplistValue v;
+  if (bplist_lookup(ctx, path, &v) != 0)
+    fail("not found", path);
+  else if ((v.type != PLIST_STRING) || v.utf16 || (v.length != strlen(s)) ||
+           (memcmp(v.bytes, s, v.length) != 0))
+    fail("not the expected string", path);
+}
+
+static void expect_int(const BplistCtx *ctx, const char *path, int64_t i) {
+  BplistValue v;
+  if (bplist_lookup(ctx, path, &v) != 0)
+    fail("not found", path);
+  else if ((v.type != PLIST_INTEGER) || (v.v.integer != i))
+    fail("not the expected integer", path);
+}
+
+static void expect_container(const BplistCtx *ctx, const char *path, PlistType type,
+                             uint64_t count, uint64_t index) {
+  BplistValue v;
+  if (bplist_lookup(ctx, path, &v) != 0)
+    fail("not found", path);
+  else if ((v.type != type) || (v.count != count) || (v.index != index))
+    fail("not the expected container", path);
+}
+
+static void test_lookup(void) {
+  PlistWriter w;
+  BplistCtx ctx;
+  make_plist(&w);
+  if (bplist_open(&ctx, (const char *)w.buf, w.length) != 0) {
+    fail("bplist_open() failed", "");
+    return;
+  }
+  expect_container(&ctx, "", PLIST_DICT, 4, ctx.top_object);
+  expect_string(&ctx, "type", "updateNowPlaying");
+  expect_string(&ctx, "params/title", "Song");
+  expect_int(&ctx, "params/caf\xc3\xa9", 7); // the key is UTF-16 in the plist
+  expect_missing(&ctx, "params/cafe");
+  expect_missing(&ctx, "params/caf\xc3\xa9s");
+  expect_missing(&ctx, "params/caf");
+  expect_container(&ctx, "list", PLIST_ARRAY, 3, 11);
+  expect_string(&ctx, "list/0", "zero");
+  expect_int(&ctx, "list/2", 42);
+  expect_missing(&ctx, "list/3");
+  expect_missing(&ctx, "list/-1");
+  expect_missing(&ctx, "list/x");
+  // the same dict, reached three ways
+  expect_container(&ctx, "params", PLIST_DICT, 2, 4);
+  expect_container(&ctx, "list/1", PLIST_DICT, 2, 4);
+  expect_container(&ctx, "alias", PLIST_DICT, 2, 4);
+  expect_string(&ctx, "list/1/title", "Song");
+  expect_int(&ctx, "alias/caf\xc3\xa9", 7);
+  expect_missing(&ctx, "missing");
+  expect_missing(&ctx, "type/0");
+  expect_missing(&ctx, "params/title/x");
+}
+
+// node as printed by plist_fprint(), in a string to be freed
+static char *printed(const PlistNode *node) {
+  char *s = NULL;
+  size_t length;
+  FILE *f = open_memstream(&s, &length);
+  if (f == NULL) {
+    perror("open_memstream");
+    exit(EXIT_FAILURE);
+  }
+  plist_fprint(f, node, 0);
+  fclose(f);
+  return s;
+}
+
+// A dict of n entries, "key0": 0, "key1": 1 and so on. Big ones are hash-indexed when decoded.
+static void make_big_dict(PlistWriter *w, int n) {
+  int keys[100], values[100];
+  char key[16];
+  memset(w, 0, sizeof(PlistWriter));
+  put(w, "bplist00", 8);
+  for (int i = 0; i < n; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    keys[i] = add_string(w, key);
+    values[i] = add_int(w, i);
+  }
+  finish(w, add_dict(w, n, keys, values));
+}
+
+// Check that a scalar node prints as want.
+static void expect_printed(const PlistNode *node, const char *what, const char *want) {
+  if (node == NULL) {
+    fail("not found", what);
+    return;
+  }
+  char *s = printed(node), *p = s, *end = s + strlen(s);
+  while (*p == ' ')
+    p++;
+  while ((end > p) && (end[-1] == '\n'))
+    *--end = '\0';
+  if (strcmp(p, want) != 0) {
+    fprintf(stderr, "\"%s\": got %s, expected %s\n", what, p, want);
+    failures++;
+  }
+  free(s);
+}
+
+static void test_tree(void) {
+  PlistWriter w;
+  make_plist(&w);
+  PlistNode *root = plist_parse_binary((const char *)w.buf, w.length);
+  if (root == NULL) {
+    fail("plist_parse_binary() failed", "");
+    return;
+  }
+  // entries are kept in the order they're in the plist
+  char *s = printed(root);
+  char *type = strstr(s, "type: "), *params_key = strstr(s, "params: ");
+  char *list = strstr(s, "list: "), *alias = strstr(s, "alias: ");
+  if (!type || !params_key || !list || !alias || (type > params_key) || (params_key > list) ||
+      (list > alias))
+    fail("not printed in order", "");
+  free(s);
+  PlistNode *params = plist_dict_get(root, "params");
+  expect_printed(plist_dict_get(params, "caf\xc3\xa9"), "params/caf\xc3\xa9", "7");
+  expect_printed(plist_dict_get(params, "title"), "params/title", "\"Song\"");
+  if (plist_dict_get(root, "alias") != params)
+    fail("not the same node as \"params\"", "alias");
+  if (plist_dict_get(params, "cafe") != NULL)
+    fail("found, but it isn't there", "params/cafe");
+  if (plist_dict_get(root, "missing") != NULL)
+    fail("found, but it isn't there", "missing");
+  if (plist_dict_get(plist_dict_get(root, "list"), "0") != NULL)
+    fail("found, but an array isn't a dict", "list/0");
+  plist_free(root);
+
+  for (int n = 1; n <= 100; n += 33) {
+    make_big_dict(&w, n);
+    root = plist_parse_binary((const char *)w.buf, w.length);
+    if (root == NULL) {
+      fail("plist_parse_binary() failed", "");
+      continue;
+    }
+    char key[32], value[16];
+    for (int i = 0; i < n; i++) {
+      snprintf(key, sizeof(key), "key%d", i);
+      snprintf(value, sizeof(value), "%d", i);
+      expect_printed(plist_dict_get(root, key), key, value);
+    }
+    snprintf(key, sizeof(key), "key%d", n);
+    if ((plist_dict_get(root, key) != NULL) || (plist_dict_get(root, "key") != NULL))
+      fail("found, but it isn't there", key);
+    // entries are kept in the order they're in the plist
+    s = printed(root);
+    int next = 0;
+    for (char *line = strtok(s, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+      while (*line == ' ')
+        line++;
+      snprintf(key, sizeof(key), "key%d: %d", next, next);
+      if (strcmp(line, key) == 0)
+        next++;
+    }
+    if (next != n)
+      fail("not printed in order", "the big dict");
+    free(s);
+    plist_free(root);
+  }
+}
+
+static void test_limits(void) {
+  BplistLimits saved, limits;
+  PlistWriter w;
+  PlistNode *root;
+  make_plist(&w);
+  bplist_get_limits(&saved);
+
+  limits = saved;
+  limits.max_objects = w.count - 1;
+  bplist_set_limits(&limits);
+  root = plist_parse_binary((const char *)w.buf, w.length);
+  if (root != NULL) {
+    fail("decoded with more than max_objects objects", "");
+    plist_free(root);
+  }
+
+  limits = saved;
+  limits.max_decoded_bytes = 16;
+  bplist_set_limits(&limits);
+  root = plist_parse_binary((const char *)w.buf, w.length);
+  if (root != NULL) {
+    fail("decoded with more than max_decoded_bytes bytes", "");
+    plist_free(root);
+  }
+
+  // containers nested more deeply than the limit are decoded as null, so only the top level
+  // is left
+  limits = saved;
+  limits.max_depth = 1;
+  bplist_set_limits(&limits);
+  root = plist_parse_binary((const char *)w.buf, w.length);
+  if (root == NULL) {
+    fail("not decoded with max_depth 1", "");
+  } else {
+    char *s = printed(root);
+    if ((strstr(s, "updateNowPlaying") == NULL) || (strstr(s, "Song") != NULL))
+      fail("not cut short at max_depth 1", "");
+    free(s);
+    plist_free(root);
+  }
+
+  bplist_set_limits(&saved);
+  root = plist_parse_binary((const char *)w.buf, w.length);
+  if (root == NULL) {
+    fail("not decoded within the default limits", "");
+  } else {
+    char *s = printed(root);
+    if (strstr(s, "Song") == NULL)
+      fail("cut short within the default limits", "");
+    free(s);
+    plist_free(root);
+  }
+}
+
+// { "first": <shared>, "second": [ <shared> ] }, or with the entries the other way round,
+// where <shared> is [ [ "deep" ] ], the same object each time.
+static void make_shared_plist(PlistWriter *w, int second_first) {
+  memset(w, 0, sizeof(PlistWriter));
+  put(w, "bplist00", 8);
+  int deep = add_string(w, "deep");
+  int inner = add_array(w, 1, &deep);
+  int shared = add_array(w, 1, &inner);
+  int outer = add_array(w, 1, &shared);
+  int keys[2], values[2];
+  keys[!!second_first] = add_string(w, "first");
+  values[!!second_first] = shared;
+  keys[!second_first] = add_string(w, "second");
+  values[!second_first] = outer;
+  finish(w, add_dict(w, 2, keys, values));
+}
+
+// Check that a node prints as want in JSON.
+static void expect_json(const PlistNode *node, const char *what, const char *want) {
+  if (node == NULL) {
+    fail("not found", what);
+    return;
+  }
+  char *s = NULL;
+  size_t length;
+  FILE *f = open_memstream(&s, &length);
+  if (f == NULL) {
+    perror("open_memstream");
+    exit(EXIT_FAILURE);
+  }
+  plist_fprint_json(f, node, 0);
+  fclose(f);
+  if (strcmp(s, want) != 0) {
+    fprintf(stderr, "\"%s\": got %s, expected %s\n", what, s, want);
+    failures++;
+  }
+  free(s);
+}
+
+// max_depth holds on every path: an object shared by containers at different depths is cut
+// short where it's nested too deeply, and only there, whichever path it's decoded on first.
+static void test_shared_depth(void) {
+  BplistLimits saved, limits;
+  bplist_get_limits(&saved);
+  limits = saved;
+  limits.max_depth = 3;
+  bplist_set_limits(&limits);
+  for (int second_first = 0; second_first <= 1; second_first++) {
+    PlistWriter w;
+    make_shared_plist(&w, second_first);
+    PlistNode *root = plist_parse_binary((const char *)w.buf, w.length);
+    if (root == NULL) {
+      fail("plist_parse_binary() failed", "");
+      continue;
+    }
+    expect_json(plist_dict_get(root, "first"), "first", "[[\"deep\"]]");
+    expect_json(plist_dict_get(root, "second"), "second", "[[null]]");
+    plist_free(root);
+  }
+  bplist_set_limits(&saved);
+}
+
+int main(void) {
+  test_lookup();
+  test_tree();
+  test_limits();
+  test_shared_depth();
+  printf("%s\n", failures == 0 ? "ok" : "FAILED");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,158 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Checks that the reader sleeps, rather than spinning, while the writer of its named pipe is
+// disconnected: the reader is started on a FIFO, sent an item, and the writer closes the pipe.
+// After a second the reader is stopped and the CPU time it used is compared with a threshold.
+// This is done with the input on stdin, with the pipelined reader and with a PIPE argument.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define IDLE_MS 1000
+#define MAX_CPU_MS 100 // a reader spinning at EOF would use nearly all of IDLE_MS
+
+static const char item[] = "<item><type>73736e63</type><code>70666c73</code><length>0</length>"
+                           "</item>\n";
+
+static void sleep_ms(long ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+  while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR))
+    ;
+}
+
+// Open the FIFO for writing once the reader has it open, send an item and close it.
+// Returns -1 if the reader doesn't open it within a few seconds.
+static int write_item(const char *fifo) {
+  int fd, tries = 0;
+  while ((fd = open(fifo, O_WRONLY | O_NONBLOCK)) < 0) {
+    if ((errno != ENXIO) || (++tries == 500))
+      return -1;
+    sleep_ms(10);
+  }
+  fcntl(fd, F_SETFL, 0);
+  if (write(fd, item, sizeof(item) - 1) != (ssize_t)(sizeof(item) - 1))
+    die("could not write to \"%s\": %s", fifo, strerror(errno));
+  close(fd);
+  return 0;
+}
+
+// Returns 0 if the reader stayed idle while disconnected, -1 otherwise.
+static int run(const char *name, const char *reader, const char *fifo, int on_stdin,
+               char **options) {
+  char *argv[8];
+  int argc = 0;
+  argv[argc++] = (char *)reader;
+  while (*options)
+    argv[argc++] = *options++;
+  if (!on_stdin)
+    argv[argc++] = (char *)fifo;
+  argv[argc] = NULL;
+
+  pid_t pid = fork();
+  if (pid < 0)
+    die("could not fork: %s", strerror(errno));
+  if (pid == 0) {
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd >= 0)
+      dup2(fd, STDOUT_FILENO);
+    if (on_stdin) {
+      fd = open(fifo, O_RDONLY);
+      if (fd < 0) {
+        fprintf(stderr, "could not open \"%s\": %s\n", fifo, strerror(errno));
+        _exit(127);
+      }
+      dup2(fd, STDIN_FILENO);
+    }
+    execv(reader, argv);
+    fprintf(stderr, "could not run \"%s\": %s\n", reader, strerror(errno));
+    _exit(127);
+  }
+
+  int status;
+  const char *problem = NULL;
+  if (write_item(fifo) != 0)
+    problem = "the reader didn't open the pipe";
+  else {
+    sleep_ms(IDLE_MS);
+    if (waitpid(pid, &status, WNOHANG) != 0) {
+      printf("%s: the reader exited while the writer was disconnected\n", name);
+      return -1;
+    }
+    // It should still be waiting for the next writer.
+    if (write_item(fifo) != 0)
+      problem = "the reader didn't reopen the pipe";
+    else
+      sleep_ms(100);
+  }
+  kill(pid, SIGTERM);
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0)
+    die("could not wait for the reader: %s", strerror(errno));
+  long cpu_ms = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+                (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+  if (problem) {
+    printf("%s: %s\n", name, problem);
+    return -1;
+  }
+  int ok = cpu_ms <= MAX_CPU_MS;
+  printf("%s: %ld ms of CPU time in %d ms -- %s\n", name, cpu_ms, IDLE_MS + 100,
+         ok ? "ok" : "FAILED");
+  return ok ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+  const char *reader = argc > 1 ? argv[1] : "./shairport-sync-metadata-reader";
+  char dir[] = "/tmp/test-fifo-eof.XXXXXX";
+  char fifo[sizeof(dir) + 16];
+  static char *no_options[] = {NULL};
+  static char *threads[] = {"--threads", "2", NULL};
+  int failures = 0;
+
+  if (mkdtemp(dir) == NULL)
+    die("could not make a temporary directory: %s", strerror(errno));
+  snprintf(fifo, sizeof(fifo), "%s/fifo", dir);
+  if (mkfifo(fifo, 0600) != 0)
+    die("could not make \"%s\": %s", fifo, strerror(errno));
+
+  if (run("stdin", reader, fifo, 1, no_options) != 0)
+    failures++;
+  if (run("stdin, pipelined", reader, fifo, 1, threads) != 0)
+    failures++;
+  if (run("pipe argument", reader, fifo, 0, no_options) != 0)
+    failures++;
+
+  unlink(fifo);
+  rmdir(dir);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,260 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Checks the incremental metadata parser. A stream with items, junk lines, an item too long to
+// be accepted, one without its closing tags and one without a data section is written to a
+// non-blocking pipe in pieces of every size from one byte up, so that every tag and every
+// base64 text is split across reads at every point, and what the parser makes of it is
+// compared with what's expected. The same stream is also parsed from a buffer. Then a line
+// much longer than METADATA_PARSER_MAX_LINE is sent, to check that it comes back as junk
+// without the parser's buffer growing to hold it.
+
+#include "../utilities/metadata-parser.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char stream[] =
+    "<item><type>636f7265</type><code>6d696e6d</code><length>4</length>\n"
+    "<data encoding=\"base64\">\n"
+    "U29uZw==</data></item>\n"
+    "<item><type>73736e63</type><code>70626567</code><length>0</length></item>\n"
+    "some junk\n"
+    "<item><type>zz</type><code>6d696e6d</code><length>0</length></item>\n"
+    // over METADATA_PARSER_MAX_ITEM, so dropped
+    "<item><type>636f7265</type><code>61736172</code><length>67108865</length>\n"
+    "<data encoding=\"base64\">\n"
+    "QWJi</data></item>\n"
+    // no </data></item>, so the data runs up to the next item
+    "<item><type>636f7265</type><code>6173616c</code><length>5</length>\n"
+    "<data encoding=\"base64\">\n"
+    "QWxidW0=\n"
+    "<item><type>636f7265</type><code>61736172</code><length>6</length>\n"
+    "<data encoding=\"base64\">\n"
+    "QXJ0aXN0</data></item>\n"
+    "\r\n"
+    // no data section, although the length isn't 0
+    "<item><type>73736e63</type><code>70656e64</code><length>3</length>\n"
+    "<item><type>73736e63</type><code>6d64656e</code><length>0</length></item>\n";
+
+static const char expected[] =
+    "item core/minm 4 \"U29uZw==\"\n"
+    "item ssnc/pbeg 0 \"\"\n"
+    "junk \"some junk\\n\"\n"
+    "junk \"<item><type>zz</type><code>6d696e6d</code><length>0</length></item>\\n\"\n"
+    "item core/asal 5 \"QWxidW0=\\n\" no end tag\n"
+    "item core/asar 6 \"QXJ0aXN0\"\n"
+    "item ssnc/pend 3 \"\"\n"
+    "item ssnc/mden 0 \"\"\n";
+
+#define LONG_LINE_LENGTH (300 * 1000)
+
+static int failures = 0;
+
+static void print_code(FILE *out, uint32_t code) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    fputc((int)((code >> shift) & 0xff), out);
+}
+
+static void print_text(FILE *out, const char *text, size_t length) {
+  fputc('"', out);
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] == '\n')
+      fputs("\\n", out);
+    else
+      fputc(text[i], out);
+  }
+  fputc('"', out);
+}
+
+// Describe an item or a junk line on a line of its own.
+static void describe(FILE *out, MetadataParserStatus status, const MetadataItem *item) {
+  if (status == METADATA_PARSER_JUNK) {
+    fputs("junk ", out);
+    print_text(out, item->data, item->data_length);
+  } else {
+    fputs("item ", out);
+    print_code(out, item->type);
+    fputc('/', out);
+    print_code(out, item->code);
+    fprintf(out, " %zu ", item->length);
+    print_text(out, item->data, item->data_length);
+    if (item->flags & METADATA_ITEM_NO_END_TAG)
+      fputs(" no end tag", out);
+  }
+  fputc('\n', out);
+}
+
+// Take everything the parser can make of the input so far. Returns the last status.
+static MetadataParserStatus drain(MetadataParser *parser, FILE *out) {
+  while (1) {
+    MetadataItem item;
+    MetadataParserStatus status = metadata_parser_next(parser, &item);
+    if ((status == METADATA_PARSER_ITEM) || (status == METADATA_PARSER_JUNK))
+      describe(out, status, &item);
+    else
+      return status;
+  }
+}
+
+// Parse the stream, written to a pipe piece bytes at a time, and return what was made of it.
+static char *parse_in_pieces(const char *text, size_t length, size_t piece) {
+  int fd[2];
+  if (pipe(fd) != 0)
+    die("could not make a pipe: %s", strerror(errno));
+  fcntl(fd[0], F_SETFL, O_NONBLOCK);
+  char *result = NULL;
+  size_t result_length = 0;
+  FILE *out = open_memstream(&result, &result_length);
+  MetadataParser parser;
+  metadata_parser_init(&parser, fd[0]);
+  for (size_t done = 0; done < length; done += piece) {
+    size_t n = length - done < piece ? length - done : piece;
+    if (write(fd[1], text + done, n) != (ssize_t)n)
+      die("could not write to the pipe: %s", strerror(errno));
+    if ((drain(&parser, out) != METADATA_PARSER_ERROR) || (errno != EAGAIN))
+      fputs("didn't wait for more input\n", out);
+  }
+  close(fd[1]);
+  if (drain(&parser, out) != METADATA_PARSER_EOF)
+    fputs("didn't reach the end of the input\n", out);
+  metadata_parser_free(&parser);
+  close(fd[0]);
+  fclose(out);
+  return result;
+}
+
+static void test_pieces(void) {
+  for (size_t piece = 1; piece <= sizeof(stream) - 1; piece++) {
+    char *result = parse_in_pieces(stream, sizeof(stream) - 1, piece);
+    if (strcmp(result, expected) != 0) {
+      printf("in pieces of %zu bytes, the stream was parsed as:\n%s", piece, result);
+      failures++;
+      free(result);
+      break; // the other sizes are probably wrong in the same way
+    }
+    free(result);
+  }
+}
+
+static void test_buffer(void) {
+  char text[sizeof(stream)];
+  memcpy(text, stream, sizeof(stream));
+  char *result = NULL;
+  size_t result_length = 0;
+  FILE *out = open_memstream(&result, &result_length);
+  MetadataParser parser;
+  metadata_parser_init_buffer(&parser, text, sizeof(stream) - 1);
+  if (drain(&parser, out) != METADATA_PARSER_EOF)
+    fputs("didn't reach the end of the input\n", out);
+  metadata_parser_free(&parser);
+  fclose(out);
+  if (strcmp(result, expected) != 0) {
+    printf("from a buffer, the stream was parsed as:\n%s", result);
+    failures++;
+  }
+  free(result);
+}
+
+// A line far longer than METADATA_PARSER_MAX_LINE, followed by an item, in pieces.
+static void test_long_line(size_t piece) {
+  static const char item[] = "<item><type>73736e63</type><code>6d64656e</code><length>0</length>"
+                             "</item>\n";
+  size_t length = LONG_LINE_LENGTH + 1 + sizeof(item) - 1;
+  char *text = malloc(length);
+  if (text == NULL)
+    die("could not allocate the long line");
+  memset(text, 'x', LONG_LINE_LENGTH);
+  text[LONG_LINE_LENGTH] = '\n';
+  memcpy(text + LONG_LINE_LENGTH + 1, item, sizeof(item) - 1);
+
+  int fd[2];
+  if (pipe(fd) != 0)
+    die("could not make a pipe: %s", strerror(errno));
+  fcntl(fd[0], F_SETFL, O_NONBLOCK);
+  MetadataParser parser;
+  metadata_parser_init(&parser, fd[0]);
+  size_t initial_size = parser.size;
+  size_t largest_size = parser.size, junk_length = 0, longest_piece = 0;
+  int junk_ok = 1, items = 0;
+  for (size_t done = 0; done < length; done += piece) {
+    size_t n = length - done < piece ? length - done : piece;
+    if (write(fd[1], text + done, n) != (ssize_t)n)
+      die("could not write to the pipe: %s", strerror(errno));
+    if (done + n == length)
+      close(fd[1]);
+    while (1) {
+      MetadataItem got;
+      MetadataParserStatus status = metadata_parser_next(&parser, &got);
+      if (parser.size > largest_size)
+        largest_size = parser.size;
+      if (status == METADATA_PARSER_JUNK) {
+        // every piece is part of the line, and only the last one has its newline
+        for (size_t i = 0; i < got.data_length; i++)
+          if (got.data[i] != (junk_length + i < LONG_LINE_LENGTH ? 'x' : '\n'))
+            junk_ok = 0;
+        junk_length += got.data_length;
+        if (got.data_length > longest_piece)
+          longest_piece = got.data_length;
+      } else if (status == METADATA_PARSER_ITEM) {
+        if (junk_length != LONG_LINE_LENGTH + 1)
+          junk_ok = 0; // the item was returned before the end of the line
+        items++;
+      } else {
+        break;
+      }
+    }
+  }
+  metadata_parser_free(&parser);
+  close(fd[0]);
+  free(text);
+
+  if (!junk_ok || (junk_length != LONG_LINE_LENGTH + 1) || (items != 1)) {
+    printf("in pieces of %zu bytes, a long line came back as %zu bytes of junk and %d items\n",
+           piece, junk_length, items);
+    failures++;
+  }
+  if (largest_size > initial_size) {
+    printf("in pieces of %zu bytes, a long line grew the buffer from %zu to %zu bytes\n", piece,
+           initial_size, largest_size);
+    failures++;
+  }
+  if (longest_piece > initial_size) {
+    printf("in pieces of %zu bytes, a long line came back in pieces of up to %zu bytes\n", piece,
+           longest_piece);
+    failures++;
+  }
+}
+
+int main(void) {
+  test_pieces();
+  test_buffer();
+  test_long_line(1);
+  test_long_line(METADATA_PARSER_MAX_LINE + 1);
+  test_long_line(65536);
+  printf("%s\n", failures == 0 ? "ok" : "FAILED");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
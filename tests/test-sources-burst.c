@@ -0,0 +1,160 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Checks that a burst of items on one of several metadata pipes is printed in full while its
+// writer is still connected. The reader takes only so many items from a pipe at a time before
+// seeing to the others, so the rest of a burst can be left in the pipe's parser, where epoll
+// knows nothing about it. The reader is started on two FIFOs, the burst is written to one of
+// them in a single write, and its output is read until every item has been printed or nothing
+// more arrives for a while.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BURST_ITEMS 300 // well over the number taken from a pipe at a time
+#define QUIET_MS 2000   // how long to wait for more output before giving up
+
+static const char item[] = "<item><type>636f7265</type><code>6d696e6d</code><length>4</length>\n"
+                           "<data encoding=\"base64\">\n"
+                           "U29uZw==</data></item>\n";
+static const char line[] = "[burst] Title: \"Song\".\n";
+
+static void sleep_ms(long ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+  while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR))
+    ;
+}
+
+// Open the FIFO for writing once the reader has it open. Returns -1 if the reader doesn't
+// open it within a few seconds.
+static int open_writer(const char *fifo) {
+  int fd, tries = 0;
+  while ((fd = open(fifo, O_WRONLY | O_NONBLOCK)) < 0) {
+    if ((errno != ENXIO) || (++tries == 500))
+      return -1;
+    sleep_ms(10);
+  }
+  fcntl(fd, F_SETFL, 0);
+  return fd;
+}
+
+// Read the reader's output until BURST_ITEMS lines have arrived or none arrives for QUIET_MS.
+// Returns the number of lines that were as expected, or -1 if one wasn't.
+static int read_lines(int fd) {
+  char buf[4096], pending[sizeof(line)];
+  size_t pending_length = 0;
+  int lines = 0;
+  struct pollfd pfd = {.fd = fd, .events = POLLIN};
+  while ((lines < BURST_ITEMS) && (poll(&pfd, 1, QUIET_MS) > 0)) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0)
+      break;
+    for (ssize_t i = 0; i < n; i++) {
+      if (pending_length == sizeof(line) - 1)
+        return -1;
+      pending[pending_length++] = buf[i];
+      if (buf[i] == '\n') {
+        if ((pending_length != sizeof(line) - 1) || (memcmp(pending, line, pending_length) != 0))
+          return -1;
+        pending_length = 0;
+        lines++;
+      }
+    }
+  }
+  return lines;
+}
+
+int main(int argc, char **argv) {
+  const char *reader = argc > 1 ? argv[1] : "./shairport-sync-metadata-reader";
+  char dir[] = "/tmp/test-sources-burst.XXXXXX";
+  char burst[sizeof(dir) + 16], quiet[sizeof(dir) + 16];
+  char burst_arg[sizeof(burst) + 8], quiet_arg[sizeof(quiet) + 8];
+
+  if (mkdtemp(dir) == NULL)
+    die("could not make a temporary directory: %s", strerror(errno));
+  snprintf(burst, sizeof(burst), "%s/burst", dir);
+  snprintf(quiet, sizeof(quiet), "%s/quiet", dir);
+  if ((mkfifo(burst, 0600) != 0) || (mkfifo(quiet, 0600) != 0))
+    die("could not make the pipes in \"%s\": %s", dir, strerror(errno));
+  snprintf(burst_arg, sizeof(burst_arg), "burst=%s", burst);
+  snprintf(quiet_arg, sizeof(quiet_arg), "quiet=%s", quiet);
+
+  int out[2];
+  if (pipe(out) != 0)
+    die("could not make a pipe: %s", strerror(errno));
+  pid_t pid = fork();
+  if (pid < 0)
+    die("could not fork: %s", strerror(errno));
+  if (pid == 0) {
+    dup2(out[1], STDOUT_FILENO);
+    close(out[0]);
+    close(out[1]);
+    execl(reader, reader, burst_arg, quiet_arg, (char *)NULL);
+    fprintf(stderr, "could not run \"%s\": %s\n", reader, strerror(errno));
+    _exit(127);
+  }
+  close(out[1]);
+
+  int result = EXIT_FAILURE;
+  int fd = open_writer(burst);
+  if (fd < 0) {
+    printf("the reader didn't open the pipe\n");
+  } else {
+    size_t length = BURST_ITEMS * (sizeof(item) - 1);
+    char *text = malloc(length);
+    if (text == NULL)
+      die("could not allocate the burst");
+    for (int i = 0; i < BURST_ITEMS; i++)
+      memcpy(text + i * (sizeof(item) - 1), item, sizeof(item) - 1);
+    if (write(fd, text, length) != (ssize_t)length)
+      die("could not write to \"%s\": %s", burst, strerror(errno));
+    free(text);
+    // The writer stays connected, so that nothing is printed because the pipe was closed.
+    int lines = read_lines(out[0]);
+    if (lines < 0)
+      printf("unexpected output\n");
+    else
+      printf("%d of the %d items were printed -- %s\n", lines, BURST_ITEMS,
+             lines == BURST_ITEMS ? "ok" : "FAILED");
+    if (lines == BURST_ITEMS)
+      result = EXIT_SUCCESS;
+    close(fd);
+  }
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  close(out[0]);
+  unlink(burst);
+  unlink(quiet);
+  rmdir(dir);
+  return result;
+}
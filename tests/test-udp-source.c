@@ -0,0 +1,244 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Checks how the reader puts chunked items received over UDP together. The reader is started
+// with --udp on a loopback port and sent datagrams: items whole and in chunks, and chunked
+// items with chunks out of order, missing, disagreeing about the number of chunks, or adding up
+// to more than UDP_SOURCE_MAX_ITEM. Each case ends with an item used as a marker, and what
+// the reader prints before the marker is compared with what's expected.
+
+#include "../utilities/udp-source.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TITLE 0x636f72656d696e6dULL // core/minm, printed as Title: "...".
+#define QUIET_MS 2000               // how long to wait for output before giving up
+
+static int sock = -1;      // connected to the reader's port
+static int output = -1;    // the reader's stdout
+static int marker = 0;     // the number of the next marker
+static char pending[4096]; // output read but not yet dealt with
+static size_t pending_length = 0;
+static int failures = 0;
+
+static void sleep_ms(long ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+  while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR))
+    ;
+}
+
+static void put_uint32(unsigned char *p, uint32_t v) {
+  v = htonl(v);
+  memcpy(p, &v, sizeof(uint32_t));
+}
+
+static void send_datagram(const void *d, size_t length) {
+  if (send(sock, d, length, 0) != (ssize_t)length)
+    die("could not send a datagram: %s", strerror(errno));
+}
+
+// Send a title in a datagram of its own.
+static void send_title(const char *title) {
+  unsigned char d[256];
+  size_t length = strlen(title);
+  put_uint32(d, TITLE >> 32);
+  put_uint32(d + 4, (uint32_t)TITLE);
+  memcpy(d + 8, title, length);
+  send_datagram(d, 8 + length);
+}
+
+// Send the chunk with this index of a title in this many chunks. The chunk's part of the
+// title is given, or if it's NULL, part_length bytes of padding.
+static void send_chunk(uint32_t index, uint32_t chunks, const char *part, size_t part_length) {
+  static unsigned char d[UDP_SOURCE_MAX_DATAGRAM];
+  if (part)
+    part_length = strlen(part);
+  memcpy(d, "ssncchnk", 8);
+  put_uint32(d + 8, index);
+  put_uint32(d + 12, chunks);
+  put_uint32(d + 16, TITLE >> 32);
+  put_uint32(d + 20, (uint32_t)TITLE);
+  if (part)
+    memcpy(d + 24, part, part_length);
+  else
+    memset(d + 24, 'x', part_length);
+  send_datagram(d, 24 + part_length);
+}
+
+// Read a line of the reader's output into line. Returns -1 if none arrives in time.
+static int read_line(char *line, size_t size) {
+  while (1) {
+    char *nl = memchr(pending, '\n', pending_length);
+    if (nl) {
+      size_t length = nl + 1 - pending;
+      if (length >= size)
+        length = size - 1;
+      memcpy(line, pending, length);
+      line[length] = '\0';
+      pending_length -= nl + 1 - pending;
+      memmove(pending, nl + 1, pending_length);
+      return 0;
+    }
+    struct pollfd pfd = {.fd = output, .events = POLLIN};
+    if ((pending_length == sizeof(pending)) || (poll(&pfd, 1, QUIET_MS) <= 0))
+      return -1;
+    ssize_t n = read(output, pending + pending_length, sizeof(pending) - pending_length);
+    if (n <= 0)
+      return -1;
+    pending_length += n;
+  }
+}
+
+// Send a marker and check that what the reader printed before it is what was expected.
+static void expect(const char *name, const char *expected) {
+  char title[32], marker_line[64], line[256];
+  snprintf(title, sizeof(title), "Marker %d", marker++);
+  snprintf(marker_line, sizeof(marker_line), "Title: \"%s\".\n", title);
+  send_title(title);
+  char got[1024] = "";
+  while (1) {
+    if (read_line(line, sizeof(line)) != 0) {
+      printf("%s: the reader printed \"%s\" and then nothing more\n", name, got);
+      failures++;
+      return;
+    }
+    if (strcmp(line, marker_line) == 0)
+      break;
+    if (strlen(got) + strlen(line) < sizeof(got))
+      strcat(got, line);
+  }
+  if (strcmp(got, expected) != 0) {
+    printf("%s: expected \"%s\", got \"%s\"\n", name, expected, got);
+    failures++;
+  }
+}
+
+// Start the reader on a free loopback port and wait for it to take datagrams.
+static pid_t start_reader(const char *reader) {
+  struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  socklen_t addr_length = sizeof(addr);
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if ((sock < 0) || (bind(sock, (struct sockaddr *)&addr, addr_length) != 0) ||
+      (getsockname(sock, (struct sockaddr *)&addr, &addr_length) != 0))
+    die("could not make a UDP socket: %s", strerror(errno));
+  // the reader is given the port this socket was bound to, which is then left free for it
+  close(sock);
+  char address[32];
+  snprintf(address, sizeof(address), "127.0.0.1:%d", ntohs(addr.sin_port));
+
+  int out[2];
+  if (pipe(out) != 0)
+    die("could not make a pipe: %s", strerror(errno));
+  pid_t pid = fork();
+  if (pid < 0)
+    die("could not fork: %s", strerror(errno));
+  if (pid == 0) {
+    dup2(out[1], STDOUT_FILENO);
+    close(out[0]);
+    close(out[1]);
+    execl(reader, reader, "--udp", address, (char *)NULL);
+    fprintf(stderr, "could not run \"%s\": %s\n", reader, strerror(errno));
+    _exit(127);
+  }
+  close(out[1]);
+  output = out[0];
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if ((sock < 0) || (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0))
+    die("could not connect a UDP socket: %s", strerror(errno));
+  // datagrams sent before the reader has bound to the port are lost, so keep sending one
+  // until it's printed
+  struct pollfd pfd = {.fd = output, .events = POLLIN};
+  for (int tries = 0; tries < 100; tries++) {
+    send(sock, "coreminmReady", 13, 0);
+    if (poll(&pfd, 1, 50) > 0)
+      break;
+  }
+  char line[256];
+  while ((read_line(line, sizeof(line)) == 0) && (strcmp(line, "Title: \"Ready\".\n") != 0))
+    ;
+  // there may be more of them on the way
+  sleep_ms(200);
+  pending_length = 0;
+  while (poll(&pfd, 1, 0) > 0)
+    if (read(output, pending, sizeof(pending)) <= 0)
+      break;
+  return pid;
+}
+
+int main(int argc, char **argv) {
+  const char *reader = argc > 1 ? argv[1] : "./shairport-sync-metadata-reader";
+  pid_t pid = start_reader(reader);
+
+  send_title("Whole");
+  expect("a whole item", "Title: \"Whole\".\n");
+
+  send_chunk(0, 3, "Put ", 0);
+  send_chunk(1, 3, "toge", 0);
+  send_chunk(2, 3, "ther", 0);
+  expect("chunks in order", "Title: \"Put together\".\n");
+
+  send_chunk(0, 3, "Out ", 0);
+  send_chunk(2, 3, "rder", 0);
+  send_chunk(1, 3, "of o", 0);
+  expect("chunks out of order", "");
+
+  send_chunk(0, 3, "Mis", 0);
+  send_chunk(2, 3, "ing", 0);
+  // the next item starts again from its first chunk
+  send_chunk(0, 2, "Next ", 0);
+  send_chunk(1, 2, "one", 0);
+  expect("a missing chunk", "Title: \"Next one\".\n");
+
+  send_chunk(0, 3, "Three", 0);
+  send_chunk(1, 2, " or two", 0);
+  send_chunk(2, 3, " chunks", 0);
+  expect("a chunk-count mismatch", "");
+
+  send_chunk(0, 0, "None", 0);
+  expect("no chunks", "");
+
+  // 65536 chunks of 1025 bytes would be more than UDP_SOURCE_MAX_ITEM, so the chunk is dropped
+  // without disturbing the item being put together
+  send_chunk(0, 2, "Still ", 0);
+  send_chunk(0, 65536, NULL, 1025);
+  send_chunk(1, 2, "whole", 0);
+  expect("a chunk of an item over the limit", "Title: \"Still whole\".\n");
+
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  close(sock);
+  close(output);
+  printf("%s\n", failures == 0 ? "ok" : "FAILED");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,172 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "artwork.h"
+#include "xxhash64.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char *artwork_directory;
+
+// the hashes of recent pictures, most recently used first
+static uint64_t recent[ARTWORK_RECENT_HASHES];
+static int recent_count;
+static pthread_mutex_t artwork_lock = PTHREAD_MUTEX_INITIALIZER; // for recent and the link
+
+static const char *extension_of(const unsigned char *data, size_t length) {
+  static const unsigned char png[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  if ((length >= 3) && (data[0] == 0xff) && (data[1] == 0xd8) && (data[2] == 0xff))
+    return "jpg";
+  if ((length >= sizeof(png)) && (memcmp(data, png, sizeof(png)) == 0))
+    return "png";
+  return "bin";
+}
+
+// If hash is in the recent list, move it to the front and return 1. Otherwise return 0, first
+// adding it at the front if add is set, dropping the least recently used one if the list is full.
+static int touch_recent(uint64_t hash, int add) {
+  int i = 0;
+  while ((i < recent_count) && (recent[i] != hash))
+    i++;
+  int found = i < recent_count;
+  if (!found && !add)
+    return 0;
+  if (!found && (recent_count < ARTWORK_RECENT_HASHES))
+    recent_count++;
+  if (i == ARTWORK_RECENT_HASHES)
+    i--; // drop the last one
+  memmove(&recent[1], &recent[0], i * sizeof(uint64_t));
+  recent[0] = hash;
+  return found;
+}
+
+// Write the picture to path by way of a temporary file. Returns 0 on success or -1 on error,
+// with errno set.
+static int write_picture(const char *path, const char *data, size_t length) {
+  char temporary[PATH_MAX];
+  snprintf(temporary, sizeof(temporary), "%s/.picture-XXXXXX", artwork_directory);
+  int fd = mkstemp(temporary);
+  if (fd < 0)
+    return -1;
+  const char *p = data;
+  size_t remaining = length;
+  while (remaining > 0) {
+    ssize_t n = write(fd, p, remaining);
+    if ((n < 0) && (errno == EINTR))
+      continue;
+    if (n < 0)
+      break;
+    p += n;
+    remaining -= n;
+  }
+  // mkstemp() makes the file readable only by its owner -- make it readable by a web server, say
+  int failed = (remaining > 0) || (fchmod(fd, 0644) != 0);
+  int saved_errno = errno;
+  if ((close(fd) != 0) && !failed) {
+    failed = 1;
+    saved_errno = errno;
+  }
+  if (!failed && (rename(temporary, path) != 0)) {
+    failed = 1;
+    saved_errno = errno;
+  }
+  if (failed) {
+    unlink(temporary);
+    errno = saved_errno;
+    return -1;
+  }
+  return 0;
+}
+
+// Point the "current" link at name, replacing the old link in one step.
+static void link_current(const char *name) {
+  char temporary[PATH_MAX], link[PATH_MAX];
+  snprintf(temporary, sizeof(temporary), "%s/.current", artwork_directory);
+  snprintf(link, sizeof(link), "%s/current", artwork_directory);
+  unlink(temporary);
+  if ((symlink(name, temporary) != 0) || (rename(temporary, link) != 0))
+    warn("could not link \"%s\" to the latest picture: %s", link, strerror(errno));
+}
+
+int artwork_save(const char *data, size_t length, char *path, size_t path_size) {
+  uint64_t hash = xxhash64(data, length, 0);
+  char name[32];
+  snprintf(name, sizeof(name), "%016" PRIx64 ".%s", hash,
+           extension_of((const unsigned char *)data, length));
+  snprintf(path, path_size, "%s/%s", artwork_directory, name);
+  pthread_mutex_lock(&artwork_lock);
+  int seen = touch_recent(hash, 0);
+  pthread_mutex_unlock(&artwork_lock);
+  // if it's not been seen recently, it may still be there from before -- it's only remembered
+  // once it's been written, so the link never points at a file that isn't there yet
+  struct stat st;
+  int written = 0;
+  if (!seen && ((stat(path, &st) != 0) || ((size_t)st.st_size != length))) {
+    if (write_picture(path, data, length) != 0) {
+      warn("could not save a picture to \"%s\": %s", path, strerror(errno));
+      return -1;
+    }
+    written = 1;
+  }
+  pthread_mutex_lock(&artwork_lock);
+  touch_recent(hash, 1);
+  link_current(name);
+  pthread_mutex_unlock(&artwork_lock);
+  return written;
+}
+
+static void save_picture(FILE *out, __attribute__((unused)) const ItemHandler *handler,
+                         const ItemPayload *payload) {
+  fprintf(out, "Picture received, length %zu bytes", payload->length);
+  if (payload->data_length == 0) {
+    fprintf(out, ".\n");
+    return;
+  }
+  char path[PATH_MAX];
+  int saved = artwork_save(payload->data, payload->data_length, path, sizeof(path));
+  if (saved < 0)
+    fprintf(out, ", not saved.\n");
+  else
+    fprintf(out, ", %s \"%s\".\n", saved ? "saved as" : "already saved as", path);
+}
+
+static const ItemHandler picture_handler = {'ssnc', 'PICT', ITEM_DECODE_LENGTH, NULL, NULL, 0,
+                                            save_picture};
+
+void artwork_init(const char *directory) {
+  if ((mkdir(directory, 0755) != 0) && (errno != EEXIST))
+    die("could not create the artwork directory \"%s\": %s", directory, strerror(errno));
+  artwork_directory = strdup(directory);
+  item_handler_register(&picture_handler);
+}
+
+int artwork_enabled(void) { return artwork_directory != NULL; }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "item-handlers.h"
+
+// Saving the pictures sent as ssnc/PICT items to a directory.
+//
+// Each picture is written to a file named by the XXH64 hash of its contents, with an extension
+// from its magic bytes -- e.g. 3f2a9c0b51d4e687.jpg -- and a symbolic link called "current" in the
+// directory is pointed at the latest one. Files are written to a temporary name and renamed into
+// place, so a reader never sees a partly-written picture.
+//
+// Pictures are often sent again, e.g. an album's artwork with every track, so the hashes of the
+// most recent ARTWORK_RECENT_HASHES pictures are remembered and a picture seen recently just has
+// the link pointed at it, without being written again.
+
+#define ARTWORK_RECENT_HASHES 64
+
+// Save pictures to directory from now on, by registering a handler for ssnc/PICT items.
+// The directory is created if it doesn't exist. Call this after item_handlers_init().
+void artwork_init(const char *directory);
+
+// Returns 1 if pictures are being saved.
+int artwork_enabled(void);
+
+// Save a picture, returning its path in path. Returns 1 if it was saved, 0 if it had been
+// already or -1 if it couldn't be, with a warning. Use this to save pictures from a formatter
+// other than the registered handler.
+int artwork_save(const char *data, size_t length, char *path, size_t path_size);
@@ -0,0 +1,252 @@
+/*
+MIT License
+
+Copyright (c) 2015--2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// The scalar decoder started out From Stack Overflow, with thanks:
+// http://stackoverflow.com/questions/342409/how-do-i-base64-encode-decode-in-c
+// The vectorised decoders use the pshufb lookup and validation technique of Wojciech Muła
+// and Alfred Klomp -- see http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+
+#include "base64.h"
+#include <stdint.h>
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86_SIMD
+#include <immintrin.h>
+#endif
+
+static const char encoding_table[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L',
+                                      'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',
+                                      'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j',
+                                      'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
+                                      'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7',
+                                      '8', '9', '+', '/'};
+
+#define BASE64_INVALID 0xFF
+
+// an incoming char can range over ASCII, but by mistake could be all 8 bits.
+// Anything that isn't in the encoding table maps to BASE64_INVALID.
+static uint8_t decoding_table[256];
+
+// Decode as many whole blocks as possible, stopping before a block with anything other than
+// base64 characters in it. Returns the number of bytes written; *consumed is set to the number
+// of input bytes used. Never writes beyond output_capacity.
+typedef size_t (*block_decoder)(const unsigned char *in, size_t input_length, unsigned char *out,
+                                size_t output_capacity, size_t *consumed);
+
+static size_t decode_blocks_none(__attribute__((unused)) const unsigned char *in,
+                                 __attribute__((unused)) size_t input_length,
+                                 __attribute__((unused)) unsigned char *out,
+                                 __attribute__((unused)) size_t output_capacity, size_t *consumed) {
+  *consumed = 0;
+  return 0;
+}
+
+#ifdef BASE64_X86_SIMD
+
+// Each 16 bytes of input gives 12 bytes of output, but 16 bytes are stored.
+__attribute__((target("sse4.1"))) static size_t
+decode_blocks_sse41(const unsigned char *in, size_t input_length, unsigned char *out,
+                    size_t output_capacity, size_t *consumed) {
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+                                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2F);
+  const __m128i pack_shuffle =
+      _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  size_t i = 0, j = 0;
+  while ((input_length - i >= 16) && (output_capacity - j >= 16)) {
+    __m128i str = _mm_loadu_si128((const __m128i *)(in + i));
+    const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+    const __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+    const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    if (!_mm_testz_si128(lo, hi))
+      break; // something other than a base64 character -- let the scalar code deal with it
+    const __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+    const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    str = _mm_add_epi8(str, roll); // now 16 sextets
+    // pack pairs of sextets into 12-bit values and then pairs of those into 24-bit values
+    const __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+    __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    packed = _mm_shuffle_epi8(packed, pack_shuffle);
+    _mm_storeu_si128((__m128i *)(out + j), packed);
+    i += 16;
+    j += 12;
+  }
+  *consumed = i;
+  return j;
+}
+
+// Each 32 bytes of input gives 24 bytes of output, but 32 bytes are stored.
+__attribute__((target("avx2"))) static size_t
+decode_blocks_avx2(const unsigned char *in, size_t input_length, unsigned char *out,
+                   size_t output_capacity, size_t *consumed) {
+  const __m256i lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B,
+      0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B,
+      0x1B, 0x1A);
+  const __m256i lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0,
+                                            0, 0, 0, 0);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+  const __m256i pack_shuffle =
+      _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4,
+                       10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m256i pack_permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+  size_t i = 0, j = 0;
+  while ((input_length - i >= 32) && (output_capacity - j >= 32)) {
+    __m256i str = _mm256_loadu_si256((const __m256i *)(in + i));
+    const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+    const __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+    const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    if (!_mm256_testz_si256(lo, hi))
+      break;
+    const __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+    const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+    str = _mm256_add_epi8(str, roll);
+    const __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+    __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    packed = _mm256_shuffle_epi8(packed, pack_shuffle); // 12 bytes at the bottom of each lane
+    packed = _mm256_permutevar8x32_epi32(packed, pack_permute);
+    _mm256_storeu_si256((__m256i *)(out + j), packed);
+    i += 32;
+    j += 24;
+  }
+  // finish off with 16-byte blocks
+  size_t sse_consumed;
+  j += decode_blocks_sse41(in + i, input_length - i, out + j, output_capacity - j, &sse_consumed);
+  *consumed = i + sse_consumed;
+  return j;
+}
+
+#endif
+
+static block_decoder decode_blocks = decode_blocks_none;
+static const char *decoder_name = "scalar";
+
+void base64_init(void) {
+  int i;
+  for (i = 0; i < 256; i++)
+    decoding_table[i] = BASE64_INVALID;
+  for (i = 0; i < 64; i++)
+    decoding_table[(unsigned char)encoding_table[i]] = i;
+  if ((base64_use_decoder("avx2") != 0) && (base64_use_decoder("sse4.1") != 0))
+    base64_use_decoder("scalar");
+}
+
+int base64_use_decoder(const char *name) {
+  if (strcmp(name, "scalar") == 0) {
+    decode_blocks = decode_blocks_none;
+    decoder_name = "scalar";
+    return 0;
+  }
+#ifdef BASE64_X86_SIMD
+  __builtin_cpu_init();
+  if ((strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+    decode_blocks = decode_blocks_avx2;
+    decoder_name = "avx2";
+    return 0;
+  }
+  if ((strcmp(name, "sse4.1") == 0) && __builtin_cpu_supports("sse4.1")) {
+    decode_blocks = decode_blocks_sse41;
+    decoder_name = "sse4.1";
+    return 0;
+  }
+#endif
+  return -1;
+}
+
+const char *base64_decoder_name(void) { return decoder_name; }
+
+static int decode(block_decoder blocks, const unsigned char *data, size_t input_length,
+                  unsigned char *decoded_data, size_t *output_length) {
+  if (input_length % 4 != 0)
+    return -1;
+  if (input_length == 0) {
+    *output_length = 0;
+    return 0;
+  }
+
+  size_t calculated_output_length = input_length / 4 * 3;
+  if (data[input_length - 1] == '=')
+    calculated_output_length--;
+  if (data[input_length - 2] == '=')
+    calculated_output_length--;
+  if (calculated_output_length > *output_length)
+    return (-1);
+
+  // everything but the last quartet, which may be padded, can be done in blocks
+  size_t body_length = input_length - 4;
+  size_t i, j;
+  j = blocks(data, body_length, decoded_data, *output_length, &i);
+
+  for (; i < body_length; i += 4) {
+    uint32_t sextet_a = decoding_table[data[i]];
+    uint32_t sextet_b = decoding_table[data[i + 1]];
+    uint32_t sextet_c = decoding_table[data[i + 2]];
+    uint32_t sextet_d = decoding_table[data[i + 3]];
+    if ((sextet_a | sextet_b | sextet_c | sextet_d) == BASE64_INVALID)
+      return -1;
+    uint32_t triple = (sextet_a << 3 * 6) + (sextet_b << 2 * 6) + (sextet_c << 1 * 6) + sextet_d;
+    decoded_data[j++] = (triple >> 2 * 8) & 0xFF;
+    decoded_data[j++] = (triple >> 1 * 8) & 0xFF;
+    decoded_data[j++] = (triple >> 0 * 8) & 0xFF;
+  }
+
+  // the last quartet -- '=' is allowed in its last one or two places only
+  uint32_t sextet_a = decoding_table[data[i]];
+  uint32_t sextet_b = decoding_table[data[i + 1]];
+  uint32_t sextet_c = data[i + 2] == '=' ? 0 : decoding_table[data[i + 2]];
+  uint32_t sextet_d = data[i + 3] == '=' ? 0 : decoding_table[data[i + 3]];
+  if (((sextet_a | sextet_b | sextet_c | sextet_d) == BASE64_INVALID) ||
+      ((data[i + 2] == '=') && (data[i + 3] != '=')))
+    return -1;
+  uint32_t triple = (sextet_a << 3 * 6) + (sextet_b << 2 * 6) + (sextet_c << 1 * 6) + sextet_d;
+  decoded_data[j++] = (triple >> 2 * 8) & 0xFF;
+  if (j < calculated_output_length)
+    decoded_data[j++] = (triple >> 1 * 8) & 0xFF;
+  if (j < calculated_output_length)
+    decoded_data[j++] = (triple >> 0 * 8) & 0xFF;
+
+  *output_length = calculated_output_length;
+  return 0;
+}
+
+int base64_decode(const unsigned char *data, size_t input_length, unsigned char *decoded_data,
+                  size_t *output_length) {
+  return decode(decode_blocks, data, input_length, decoded_data, output_length);
+}
+
+int base64_decode_scalar(const unsigned char *data, size_t input_length,
+                         unsigned char *decoded_data, size_t *output_length) {
+  return decode(decode_blocks_none, data, input_length, decoded_data, output_length);
+}
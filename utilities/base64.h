@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+
+// Call this once before decoding -- it builds the decoding table and picks the fastest
+// decoder the CPU supports (AVX2, SSE4.1 or plain C).
+void base64_init(void);
+
+// Use the named decoder -- "avx2", "sse4.1" or "scalar" -- instead of the one base64_init()
+// picked, e.g. to test it. Returns 0, or -1 if the CPU doesn't support it.
+int base64_use_decoder(const char *name);
+
+// Returns the name of the decoder in use.
+const char *base64_decoder_name(void);
+
+// Pass in a pointer to the data, its length, a pointer to the output buffer and a pointer to a
+// size_t containing its maximum length; the actual length will be returned in it.
+// Returns 0 on success or -1 if the input isn't valid base64 or won't fit.
+// The vectorised decoders store in blocks of up to 32 bytes, but never beyond *output_length.
+int base64_decode(const unsigned char *data, size_t input_length, unsigned char *decoded_data,
+                  size_t *output_length);
+
+// The plain C decoder, whatever the CPU.
+int base64_decode_scalar(const unsigned char *data, size_t input_length,
+                         unsigned char *decoded_data, size_t *output_length);
@@ -42,46 +42,36 @@ Binary plist format (summary):
 
 Object marker byte: high nibble = type, low nibble = extra info
 (either a literal small count, or 0xF meaning "count follows as its
-own int object"). See decode_object() for the type table.
+own int object"). See decode_scalar_at() and node_for() for the type table.
 
 */
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <math.h>
 #include <time.h>
 #include "bplist-print.h"
+#include "json.h"
 
 /* ---------- Tree types (same shape as the earlier in-memory model) ---------- */
 
-typedef enum {
-    PLIST_DICT,
-    PLIST_ARRAY,
-    PLIST_SET,       /* rare; binary-plist-only container type */
-    PLIST_STRING,
-    PLIST_INTEGER,
-    PLIST_REAL,
-    PLIST_BOOLEAN,
-    PLIST_DATE,
-    PLIST_DATA,
-    PLIST_UID,       /* NSKeyedArchiver object reference */
-    PLIST_NULL
-} PlistType;
-
-typedef struct PlistNode PlistNode;
-
-typedef struct PlistDictEntry {
-    char *key;
+typedef struct {
+    const char *key;
     PlistNode *value;
-    struct PlistDictEntry *next;
+    uint32_t hash;
 } PlistDictEntry;
 
 struct PlistNode {
     PlistType type;
     union {
-        struct { PlistDictEntry *head; }                dict;
+        /* entries in on-disk key order; dicts of PLIST_DICT_INDEX_MIN or
+           more entries also get an open-addressing hash index, whose slots
+           hold an entry number + 1, or 0 if empty */
+        struct { PlistDictEntry *entries; size_t count; uint32_t *index; size_t index_mask; } dict;
         struct { PlistNode **items; size_t count; size_t cap; } array;
         char    *string;    /* PLIST_STRING */
         int64_t  integer;
@@ -93,108 +83,215 @@ struct PlistNode {
     } v;
 };
 
-static PlistNode *plist_new(PlistType type) {
-    PlistNode *n = calloc(1, sizeof(PlistNode));
-    if (!n) { perror("calloc"); exit(EXIT_FAILURE); }
+/* ---------- Arena ----------
+
+   Every node, dict entry, string and data copy in a tree lives in one
+   arena, a chain of blocks allocated as the tree is built. The first
+   block is sized from the trailer's object count and the length of the
+   buffer, so most plists need just one block, and the whole tree is
+   freed by freeing the blocks. */
+
+typedef struct PlistArenaBlock {
+    struct PlistArenaBlock *next;
+    size_t size;  /* bytes available in data[] */
+    size_t used;
+    _Alignas(16) char data[];
+} PlistArenaBlock;
+
+typedef struct PlistArena {
+    PlistArenaBlock *head; /* the block being allocated from; older ones follow */
+} PlistArena;
+
+/* The root node of a tree is kept next to its arena, so that
+   plist_free() can find the arena from the root. */
+typedef struct {
+    PlistArena arena;
+    PlistNode root;
+} PlistDocument;
+
+#define PLIST_ARENA_MIN_BLOCK 4096
+
+static PlistArenaBlock *arena_block_new(size_t size) {
+    if (size < PLIST_ARENA_MIN_BLOCK) size = PLIST_ARENA_MIN_BLOCK;
+    PlistArenaBlock *b = malloc(sizeof(PlistArenaBlock) + size);
+    if (!b) { perror("malloc"); exit(EXIT_FAILURE); }
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    return b;
+}
+
+static void *arena_alloc(PlistArena *arena, size_t n) {
+    n = (n + 15) & ~(size_t)15;
+    PlistArenaBlock *b = arena->head;
+    if (b->size - b->used < n) {
+        /* start a new block at least as big as the last one */
+        PlistArenaBlock *nb = arena_block_new(n > b->size ? n : b->size);
+        nb->next = b;
+        arena->head = b = nb;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+static void arena_free(PlistArena *arena) {
+    for (PlistArenaBlock *b = arena->head; b; ) {
+        PlistArenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+}
+
+static PlistNode *plist_new(PlistArena *arena, PlistType type) {
+    PlistNode *n = arena_alloc(arena, sizeof(PlistNode));
+    memset(n, 0, sizeof(PlistNode));
     n->type = type;
     return n;
 }
 
-static PlistNode *plist_new_array_like(PlistType type) {
-    PlistNode *n = plist_new(type);
-    n->v.array.cap = 4;
-    n->v.array.items = malloc(n->v.array.cap * sizeof(PlistNode *));
+static PlistNode *plist_new_array_like(PlistArena *arena, PlistType type, size_t count) {
+    PlistNode *n = plist_new(arena, type);
+    n->v.array.cap = count;
+    n->v.array.items = arena_alloc(arena, count * sizeof(PlistNode *));
     return n;
 }
 
 static void plist_array_add(PlistNode *array, PlistNode *item) {
-    if (array->v.array.count == array->v.array.cap) {
-        array->v.array.cap *= 2;
-        array->v.array.items = realloc(array->v.array.items,
-                                        array->v.array.cap * sizeof(PlistNode *));
-    }
     array->v.array.items[array->v.array.count++] = item;
 }
 
+#define PLIST_DICT_INDEX_MIN 8
+
+/* FNV-1a */
+static uint32_t key_hash(const char *key) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++)
+        h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+static PlistNode *plist_new_dict(PlistArena *arena, size_t count) {
+    PlistNode *n = plist_new(arena, PLIST_DICT);
+    n->v.dict.entries = arena_alloc(arena, count * sizeof(PlistDictEntry));
+    return n;
+}
+
+/* Entries are added in order; there must be room for them. */
 static void plist_dict_set(PlistNode *dict, const char *key, PlistNode *value) {
-    PlistDictEntry *e = malloc(sizeof(PlistDictEntry));
-    e->key = strdup(key);
+    PlistDictEntry *e = &dict->v.dict.entries[dict->v.dict.count++];
+    e->key = key;
     e->value = value;
-    e->next = dict->v.dict.head;
-    dict->v.dict.head = e;
+    e->hash = key_hash(key);
 }
 
-void plist_free(PlistNode *node) {
-    if (!node) return;
-    switch (node->type) {
-    case PLIST_DICT:
-        for (PlistDictEntry *e = node->v.dict.head; e; ) {
-            PlistDictEntry *next = e->next;
-            free(e->key);
-            plist_free(e->value);
-            free(e);
-            e = next;
+/* Build the hash index once a big enough dict is complete. The table
+   is at least twice the number of entries, so probe runs stay short.
+   Where a key is repeated, the first entry wins, as in a linear scan. */
+static void plist_dict_build_index(PlistArena *arena, PlistNode *dict) {
+    size_t count = dict->v.dict.count;
+    if (count < PLIST_DICT_INDEX_MIN) return;
+    size_t slots = 16;
+    while (slots < count * 2) slots *= 2;
+    uint32_t *index = arena_alloc(arena, slots * sizeof(uint32_t));
+    memset(index, 0, slots * sizeof(uint32_t));
+    for (size_t i = 0; i < count; i++) {
+        const PlistDictEntry *e = &dict->v.dict.entries[i];
+        size_t slot = e->hash & (slots - 1);
+        while (index[slot] && strcmp(dict->v.dict.entries[index[slot] - 1].key, e->key) != 0)
+            slot = (slot + 1) & (slots - 1);
+        if (!index[slot])
+            index[slot] = (uint32_t)(i + 1);
+    }
+    dict->v.dict.index = index;
+    dict->v.dict.index_mask = slots - 1;
+}
+
+PlistNode *plist_dict_get(const PlistNode *dict, const char *key) {
+    if (!dict || dict->type != PLIST_DICT) return NULL;
+    const PlistDictEntry *entries = dict->v.dict.entries;
+    uint32_t hash = key_hash(key);
+    if (dict->v.dict.index) {
+        size_t mask = dict->v.dict.index_mask;
+        for (size_t slot = hash & mask; dict->v.dict.index[slot]; slot = (slot + 1) & mask) {
+            const PlistDictEntry *e = &entries[dict->v.dict.index[slot] - 1];
+            if (e->hash == hash && strcmp(e->key, key) == 0)
+                return e->value;
         }
-        break;
-    case PLIST_ARRAY:
-    case PLIST_SET:
-        for (size_t i = 0; i < node->v.array.count; i++)
-            plist_free(node->v.array.items[i]);
-        free(node->v.array.items);
-        break;
-    case PLIST_STRING:
-        free(node->v.string);
-        break;
-    case PLIST_DATA:
-        free(node->v.data.bytes);
-        break;
-    default:
-        break;
+        return NULL;
     }
-    free(node);
+    for (size_t i = 0; i < dict->v.dict.count; i++)
+        if (entries[i].hash == hash && strcmp(entries[i].key, key) == 0)
+            return entries[i].value;
+    return NULL;
+}
+
+/* Frees a whole tree returned by plist_parse_binary(), by freeing its arena.
+   Only the root of a tree can be freed. */
+void plist_free(PlistNode *root) {
+    if (!root) return;
+    PlistDocument *doc = (PlistDocument *)((char *)root - offsetof(PlistDocument, root));
+    arena_free(&doc->arena);
+}
+
+/* ---------- Limits ---------- */
+
+static BplistLimits bplist_limits = {
+    .max_depth = BPLIST_DEFAULT_MAX_DEPTH,
+    .max_objects = BPLIST_DEFAULT_MAX_OBJECTS,
+    .max_decoded_bytes = BPLIST_DEFAULT_MAX_DECODED_BYTES,
+};
+
+void bplist_set_limits(const BplistLimits *limits) {
+    bplist_limits = *limits;
+    if (bplist_limits.max_depth == 0) bplist_limits.max_depth = 1;
+}
+
+void bplist_get_limits(BplistLimits *limits) {
+    *limits = bplist_limits;
 }
 
 /* ---------- Pretty printer ---------- */
 
-static void indent(int depth) {
-    for (int i = 0; i < depth; i++) printf("    ");
+static void indent(FILE *out, int depth) {
+    for (int i = 0; i < depth; i++) fputs("    ", out);
 }
 
 #define PLIST_DATA_MAX_DISPLAY_BYTES 64
 
-static void plist_print_data(const PlistNode *node, int depth) {
+static void plist_print_data(FILE *out, const PlistNode *node, int depth) {
     size_t len = node->v.data.length;
     size_t show = len > PLIST_DATA_MAX_DISPLAY_BYTES ? PLIST_DATA_MAX_DISPLAY_BYTES : len;
 
     if ((len > strlen("bplist00")) && (strncmp(node->v.data.bytes, "bplist00", strlen("bplist00")) == 0)) {
-        printf("<bplist in a Data node, %zu byte%s>\n", len, len == 1 ? "" : "s");
-        pretty_print_binary_plist(node->v.data.bytes, len, depth);
+        fprintf(out, "<bplist in a Data node, %zu byte%s>\n", len, len == 1 ? "" : "s");
+        fpretty_print_binary_plist(out, node->v.data.bytes, len, depth);
     } else {
-      printf("<Data, %zu byte%s>\n", len, len == 1 ? "" : "s");
+      fprintf(out, "<Data, %zu byte%s>\n", len, len == 1 ? "" : "s");
       for (size_t off = 0; off < show; off += 16) {
           size_t line_len = (show - off < 16) ? (show - off) : 16;
-          indent(depth);
-          printf("%08zx  ", off);
+          indent(out, depth);
+          fprintf(out, "%08zx  ", off);
           for (size_t i = 0; i < 16; i++) {
-              if (i < line_len) printf("%02x ", node->v.data.bytes[off + i]);
-              else printf("   ");
-              if (i == 7) printf(" ");
+              if (i < line_len) fprintf(out, "%02x ", (unsigned char)node->v.data.bytes[off + i]);
+              else fputs("   ", out);
+              if (i == 7) fputc(' ', out);
           }
-          printf(" |");
+          fputs(" |", out);
           for (size_t i = 0; i < line_len; i++) {
               unsigned char c = node->v.data.bytes[off + i];
-              putchar((c >= 32 && c < 127) ? c : '.');
+              fputc((c >= 32 && c < 127) ? c : '.', out);
           }
-          printf("|\n");
+          fputs("|\n", out);
       }
       if (len > show) {
-          indent(depth);
-          printf("... (%zu more byte%s truncated)\n", len - show, (len - show) == 1 ? "" : "s");
+          indent(out, depth);
+          fprintf(out, "... (%zu more byte%s truncated)\n", len - show, (len - show) == 1 ? "" : "s");
       }
     }
 }
 
-static void plist_print_date(double cf_abs_time) {
+static void plist_print_date(FILE *out, double cf_abs_time) {
     /* CFAbsoluteTime is seconds relative to 2001-01-01T00:00:00Z.
      * Convert to a Unix time_t and format as ISO 8601 for display. */
     const time_t epoch_delta = 978307200; /* seconds between 1970-01-01 and 2001-01-01 */
@@ -203,78 +300,222 @@ static void plist_print_date(double cf_abs_time) {
     gmtime_r(&unix_time, &tm_utc);
     char buf[32];
     strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm_utc);
-    printf("<Date: %s>\n", buf);
+    fprintf(out, "<Date: %s>\n", buf);
 }
 
-void plist_print(const PlistNode *node, int depth) {
-    if (!node) { printf("<null>\n"); return; }
+/* The printer walks the tree with an explicit stack rather than by
+   recursion: a frame per container being printed, holding where it
+   has got to. */
+typedef struct {
+    const PlistNode *node;
+    size_t next; /* the next entry or item to print */
+    int depth;
+} PrintFrame;
 
+/* Prints a scalar, or the opening bracket of a container, in which case
+   it's pushed onto the stack for its contents to be printed. */
+static void print_value(FILE *out, const PlistNode *node, int depth,
+                        PrintFrame *stack, size_t *sp, size_t stack_size) {
     switch (node->type) {
-    case PLIST_DICT: {
-        printf("{\n");
-        for (PlistDictEntry *e = node->v.dict.head; e; e = e->next) {
-            indent(depth + 1);
-            printf("%s: ", e->key);
-            plist_print(e->value, depth + 1);
+    case PLIST_DICT:
+    case PLIST_ARRAY:
+    case PLIST_SET:
+        if (*sp == stack_size) {
+            fputs("<nested too deeply>\n", out);
+            return;
         }
-        indent(depth);
-        printf("}\n");
+        fputs(node->type == PLIST_DICT ? "{\n" : node->type == PLIST_SET ? "(\n" : "[\n", out);
+        stack[*sp].node = node;
+        stack[*sp].next = 0;
+        stack[*sp].depth = depth;
+        (*sp)++;
+        break;
+    case PLIST_STRING:
+        fprintf(out, "\"%s\"\n", node->v.string);
         break;
+    case PLIST_INTEGER:
+        fprintf(out, "%lld\n", (long long)node->v.integer);
+        break;
+    case PLIST_REAL:
+        fprintf(out, "%g\n", node->v.real);
+        break;
+    case PLIST_BOOLEAN:
+        fprintf(out, "%s\n", node->v.boolean ? "true" : "false");
+        break;
+    case PLIST_DATE:
+        plist_print_date(out, node->v.date);
+        break;
+    case PLIST_DATA:
+        plist_print_data(out, node, depth + 1);
+        break;
+    case PLIST_UID:
+        fprintf(out, "<UID: %llu>\n", (unsigned long long)node->v.uid);
+        break;
+    case PLIST_NULL:
+        fputs("null\n", out);
+        break;
+    }
+}
+
+void plist_fprint(FILE *out, const PlistNode *node, int depth) {
+    if (!node) { fputs("<null>\n", out); return; }
+
+    /* Shared objects are printed wherever they are referred to, so a
+       plist can print far more nodes than it has objects -- stop at the
+       object limit. */
+    uint64_t budget = bplist_limits.max_objects;
+    size_t stack_size = bplist_limits.max_depth + 1;
+    PrintFrame *stack = malloc(stack_size * sizeof(PrintFrame));
+    if (!stack) { perror("malloc"); exit(EXIT_FAILURE); }
+    size_t sp = 0;
+
+    print_value(out, node, depth, stack, &sp, stack_size);
+    while (sp > 0) {
+        PrintFrame *f = &stack[sp - 1];
+        const PlistNode *child = NULL;
+        if (f->node->type == PLIST_DICT) {
+            if (f->next < f->node->v.dict.count) {
+                const PlistDictEntry *e = &f->node->v.dict.entries[f->next++];
+                indent(out, f->depth + 1);
+                fprintf(out, "%s: ", e->key);
+                child = e->value;
+            }
+        } else if (f->next < f->node->v.array.count) {
+            indent(out, f->depth + 1);
+            child = f->node->v.array.items[f->next++];
+        }
+        if (child) {
+            if (budget-- == 0) {
+                fprintf(out, "<output truncated after %llu nodes>\n",
+                        (unsigned long long)bplist_limits.max_objects);
+                break;
+            }
+            print_value(out, child, f->depth + 1, stack, &sp, stack_size);
+        } else {
+            indent(out, f->depth);
+            fputs(f->node->type == PLIST_DICT ? "}\n" : f->node->type == PLIST_SET ? ")\n" : "]\n", out);
+            sp--;
+        }
     }
+    free(stack);
+}
+
+void plist_print(const PlistNode *node, int depth) {
+    plist_fprint(stdout, node, depth);
+}
+
+/* ---------- JSON ----------
+
+   Dicts become objects, arrays and sets become arrays, dates become
+   ISO 8601 strings and data becomes a base64 string -- or, if it holds
+   a binary plist, that plist. The output is compact and always valid:
+   whatever can't be shown, e.g. because it's nested too deeply, is
+   shown as null. */
+
+static void json_value(FILE *out, const PlistNode *node, int depth,
+                       PrintFrame *stack, size_t *sp, size_t stack_size) {
+    char buf[32];
+    switch (node->type) {
+    case PLIST_DICT:
     case PLIST_ARRAY:
-    case PLIST_SET: {
-        printf(node->type == PLIST_SET ? "(\n" : "[\n");
-        for (size_t i = 0; i < node->v.array.count; i++) {
-            indent(depth + 1);
-            plist_print(node->v.array.items[i], depth + 1);
+    case PLIST_SET:
+        if (*sp == stack_size) {
+            fputs("null", out);
+            return;
         }
-        indent(depth);
-        printf(node->type == PLIST_SET ? ")\n" : "]\n");
+        fputc(node->type == PLIST_DICT ? '{' : '[', out);
+        stack[*sp].node = node;
+        stack[*sp].next = 0;
+        stack[*sp].depth = depth;
+        (*sp)++;
         break;
-    }
     case PLIST_STRING:
-        printf("\"%s\"\n", node->v.string);
+        json_print_string(out, node->v.string, strlen(node->v.string));
         break;
     case PLIST_INTEGER:
-        printf("%lld\n", (long long)node->v.integer);
+        fprintf(out, "%lld", (long long)node->v.integer);
         break;
     case PLIST_REAL:
-        printf("%g\n", node->v.real);
+        if (isfinite(node->v.real))
+            fprintf(out, "%.17g", node->v.real);
+        else
+            fputs("null", out);
         break;
     case PLIST_BOOLEAN:
-        printf("%s\n", node->v.boolean ? "true" : "false");
+        fputs(node->v.boolean ? "true" : "false", out);
         break;
-    case PLIST_DATE:
-        plist_print_date(node->v.date);
+    case PLIST_DATE: {
+        time_t unix_time = (time_t)node->v.date + 978307200; /* see plist_print_date() */
+        struct tm tm_utc;
+        gmtime_r(&unix_time, &tm_utc);
+        strftime(buf, sizeof(buf), "\"%Y-%m-%dT%H:%M:%SZ\"", &tm_utc);
+        fputs(buf, out);
         break;
+    }
     case PLIST_DATA:
-        plist_print_data(node, depth + 1);
+        if ((node->v.data.length > strlen("bplist00")) &&
+            (strncmp(node->v.data.bytes, "bplist00", strlen("bplist00")) == 0) &&
+            (fprint_binary_plist_json(out, node->v.data.bytes, node->v.data.length, depth + 1) ==
+             EXIT_SUCCESS))
+            break;
+        json_print_base64(out, node->v.data.bytes, node->v.data.length);
         break;
     case PLIST_UID:
-        printf("<UID: %llu>\n", (unsigned long long)node->v.uid);
+        fprintf(out, "%llu", (unsigned long long)node->v.uid);
         break;
     case PLIST_NULL:
-        printf("null\n");
+        fputs("null", out);
         break;
     }
 }
 
-/* ---------- Binary plist parser ---------- */
+void plist_fprint_json(FILE *out, const PlistNode *node, int depth) {
+    if (!node) { fputs("null", out); return; }
 
-typedef struct {
-    const char *buf;
-    size_t len;
-    uint8_t  offset_size;
-    uint8_t  object_ref_size;
-    uint64_t num_objects;
-    uint64_t top_object;
-    uint64_t offset_table_offset;
-    const char *offset_table; /* points into buf */
-} BplistCtx;
+    /* as in plist_fprint(), shared objects are printed wherever they are
+       referred to -- past the object limit, they're shown as null */
+    uint64_t budget = bplist_limits.max_objects;
+    size_t stack_size = bplist_limits.max_depth + 1 > (size_t)depth
+                            ? bplist_limits.max_depth + 1 - depth : 0;
+    PrintFrame *stack = malloc((stack_size ? stack_size : 1) * sizeof(PrintFrame));
+    if (!stack) { perror("malloc"); exit(EXIT_FAILURE); }
+    size_t sp = 0;
+
+    json_value(out, node, depth, stack, &sp, stack_size);
+    while (sp > 0) {
+        PrintFrame *f = &stack[sp - 1];
+        const PlistNode *child = NULL;
+        size_t count = f->node->type == PLIST_DICT ? f->node->v.dict.count : f->node->v.array.count;
+        if (f->next < count) {
+            if (f->next > 0) fputc(',', out);
+            if (f->node->type == PLIST_DICT) {
+                const PlistDictEntry *e = &f->node->v.dict.entries[f->next];
+                json_print_string(out, e->key, strlen(e->key));
+                fputc(':', out);
+                child = e->value;
+            } else {
+                child = f->node->v.array.items[f->next];
+            }
+            f->next++;
+            if (budget == 0)
+                fputs("null", out);
+            else {
+                budget--;
+                json_value(out, child, f->depth + 1, stack, &sp, stack_size);
+            }
+        } else {
+            fputc(f->node->type == PLIST_DICT ? '}' : ']', out);
+            sp--;
+        }
+    }
+    free(stack);
+}
+
+/* ---------- Binary plist parser ---------- */
 
 static uint64_t read_be_uint(const char *p, size_t nbytes) {
     uint64_t v = 0;
-    for (size_t i = 0; i < nbytes; i++) v = (v << 8) | p[i];
+    for (size_t i = 0; i < nbytes; i++) v = (v << 8) | (uint8_t)p[i];
     return v;
 }
 
@@ -313,179 +554,559 @@ static uint64_t read_size(const char *buf, size_t off, size_t *out_header_bytes)
     return count;
 }
 
-static PlistNode *decode_object(BplistCtx *ctx, uint64_t index);
+/* How deep a container decoded once goes, to tell where it can be
+   shared -- see node_for(). */
+typedef struct {
+    uint32_t height; /* levels of containers, itself included */
+    bool cut;        /* something in it was nested too deeply, and decoded as null */
+} DecodedShape;
+
+/* The tree builder's state: the plist it's reading, and the tree it's
+   building from it. */
+typedef struct {
+    BplistCtx bp;
+    PlistArena *arena;    /* where the tree is built */
+    PlistNode **decoded;  /* the node for each object decoded so far, indexed by object */
+    DecodedShape *shapes; /* for each container in decoded */
+    uint64_t copy_budget; /* object references left to decode in copies -- see node_for() */
+} TreeCtx;
 
-static PlistNode *decode_at(BplistCtx *ctx, size_t off) {
-    uint8_t marker = ctx->buf[off];
+/* marks an object in ctx->decoded as being decoded, to catch cycles */
+static PlistNode decoding_in_progress;
+
+/* Decodes the ASCII (0x5) or UTF-16BE (0x6) string at off into a
+   NUL-terminated UTF-8 string in the arena. UTF-16 strings are
+   simplified: BMP characters only, converted to UTF-8. Surrogate pairs
+   are not handled; good starting point, extend if you need full Unicode. */
+static char *decode_string_at(TreeCtx *ctx, size_t off) {
+    size_t header;
+    uint64_t count = read_size(ctx->bp.buf, off, &header);
+    const char *p = ctx->bp.buf + off + header;
+    if ((uint8_t)ctx->bp.buf[off] >> 4 == 0x5) {
+        char *out = arena_alloc(ctx->arena, count + 1);
+        memcpy(out, p, count);
+        out[count] = '\0';
+        return out;
+    }
+    char *out = arena_alloc(ctx->arena, count * 3 + 1); /* worst case 3 bytes/UTF-8 char */
+    size_t oi = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint16_t cu = (uint16_t)read_be_uint(p + i * 2, 2);
+        if (cu < 0x80) {
+            out[oi++] = (char)cu;
+        } else if (cu < 0x800) {
+            out[oi++] = (char)(0xC0 | (cu >> 6));
+            out[oi++] = (char)(0x80 | (cu & 0x3F));
+        } else {
+            out[oi++] = (char)(0xE0 | (cu >> 12));
+            out[oi++] = (char)(0x80 | ((cu >> 6) & 0x3F));
+            out[oi++] = (char)(0x80 | (cu & 0x3F));
+        }
+    }
+    out[oi] = '\0';
+    return out;
+}
+
+/* Decodes anything but a container. There are no bounds checks here:
+   validate() has already seen to them. */
+static PlistNode *decode_scalar_at(TreeCtx *ctx, size_t off) {
+    uint8_t marker = ctx->bp.buf[off];
     uint8_t type = marker >> 4;
     uint8_t info = marker & 0x0F;
 
     switch (type) {
 
     case 0x0: /* null / bool / fill */
-        if (marker == 0x00) return plist_new(PLIST_NULL);
-        if (marker == 0x08) { PlistNode *n = plist_new(PLIST_BOOLEAN); n->v.boolean = false; return n; }
-        if (marker == 0x09) { PlistNode *n = plist_new(PLIST_BOOLEAN); n->v.boolean = true;  return n; }
-        return plist_new(PLIST_NULL); /* 0x0F fill byte, shouldn't be decoded as an object */
+        if (marker == 0x00) return plist_new(ctx->arena, PLIST_NULL);
+        if (marker == 0x08) { PlistNode *n = plist_new(ctx->arena, PLIST_BOOLEAN); n->v.boolean = false; return n; }
+        if (marker == 0x09) { PlistNode *n = plist_new(ctx->arena, PLIST_BOOLEAN); n->v.boolean = true;  return n; }
+        return plist_new(ctx->arena, PLIST_NULL); /* 0x0F fill byte, shouldn't be decoded as an object */
 
     case 0x1: { /* int: info = log2(byte count) */
         size_t nbytes = (size_t)1 << info;
-        PlistNode *n = plist_new(PLIST_INTEGER);
+        PlistNode *n = plist_new(ctx->arena, PLIST_INTEGER);
         if (nbytes >= 8) {
             /* 8-byte ints are signed two's complement; 16-byte "big" ints
              * are rare (huge integers) -- we only recover the low 64 bits. */
-            uint64_t raw = read_be_uint(ctx->buf + off + 1 + (nbytes - 8), 8);
+            uint64_t raw = read_be_uint(ctx->bp.buf + off + 1 + (nbytes - 8), 8);
             n->v.integer = (int64_t)raw;
         } else {
             /* 1/2/4-byte ints are unsigned per the format. */
-            n->v.integer = (int64_t)read_be_uint(ctx->buf + off + 1, nbytes);
+            n->v.integer = (int64_t)read_be_uint(ctx->bp.buf + off + 1, nbytes);
         }
         return n;
     }
 
     case 0x2: { /* real: info = log2(byte count), 4 (float) or 8 (double) */
         size_t nbytes = (size_t)1 << info;
-        PlistNode *n = plist_new(PLIST_REAL);
-        n->v.real = read_be_float(ctx->buf + off + 1, nbytes);
+        PlistNode *n = plist_new(ctx->arena, PLIST_REAL);
+        n->v.real = read_be_float(ctx->bp.buf + off + 1, nbytes);
         return n;
     }
 
     case 0x3: { /* date: always an 8-byte big-endian double */
-        PlistNode *n = plist_new(PLIST_DATE);
-        n->v.date = read_be_float(ctx->buf + off + 1, 8);
+        PlistNode *n = plist_new(ctx->arena, PLIST_DATE);
+        n->v.date = read_be_float(ctx->bp.buf + off + 1, 8);
         return n;
     }
 
     case 0x4: { /* data */
         size_t header;
-        uint64_t count = read_size(ctx->buf, off, &header);
-        PlistNode *n = plist_new(PLIST_DATA);
+        uint64_t count = read_size(ctx->bp.buf, off, &header);
+        PlistNode *n = plist_new(ctx->arena, PLIST_DATA);
         n->v.data.length = count;
-        n->v.data.bytes = malloc(count);
-        memcpy(n->v.data.bytes, ctx->buf + off + header, count);
-        return n;
-    }
-
-    case 0x5: { /* ASCII string */
-        size_t header;
-        uint64_t count = read_size(ctx->buf, off, &header);
-        PlistNode *n = plist_new(PLIST_STRING);
-        n->v.string = malloc(count + 1);
-        memcpy(n->v.string, ctx->buf + off + header, count);
-        n->v.string[count] = '\0';
+        n->v.data.bytes = arena_alloc(ctx->arena, count);
+        memcpy(n->v.data.bytes, ctx->bp.buf + off + header, count);
         return n;
     }
 
-    case 0x6: { /* UTF-16BE string -- simplified: BMP characters only,
-                 * converted to UTF-8. Surrogate pairs are not handled;
-                 * good starting point, extend if you need full Unicode. */
-        size_t header;
-        uint64_t count = read_size(ctx->buf, off, &header);
-        const char *p = ctx->buf + off + header;
-        char *out = malloc(count * 3 + 1); /* worst case 3 bytes/UTF-8 char */
-        size_t oi = 0;
-        for (uint64_t i = 0; i < count; i++) {
-            uint16_t cu = (uint16_t)read_be_uint(p + i * 2, 2);
-            if (cu < 0x80) {
-                out[oi++] = (char)cu;
-            } else if (cu < 0x800) {
-                out[oi++] = (char)(0xC0 | (cu >> 6));
-                out[oi++] = (char)(0x80 | (cu & 0x3F));
-            } else {
-                out[oi++] = (char)(0xE0 | (cu >> 12));
-                out[oi++] = (char)(0x80 | ((cu >> 6) & 0x3F));
-                out[oi++] = (char)(0x80 | (cu & 0x3F));
-            }
-        }
-        out[oi] = '\0';
-        PlistNode *n = plist_new(PLIST_STRING);
-        n->v.string = out;
+    case 0x5:   /* ASCII string */
+    case 0x6: { /* UTF-16BE string */
+        PlistNode *n = plist_new(ctx->arena, PLIST_STRING);
+        n->v.string = decode_string_at(ctx, off);
         return n;
     }
 
     case 0x8: { /* UID: info+1 = byte count */
         size_t nbytes = (size_t)info + 1;
-        PlistNode *n = plist_new(PLIST_UID);
-        n->v.uid = read_be_uint(ctx->buf + off + 1, nbytes);
+        PlistNode *n = plist_new(ctx->arena, PLIST_UID);
+        n->v.uid = read_be_uint(ctx->bp.buf + off + 1, nbytes);
         return n;
     }
 
-    case 0xA: /* array */
-    case 0xC: { /* set */
-        size_t header;
-        uint64_t count = read_size(ctx->buf, off, &header);
-        PlistNode *n = plist_new_array_like(type == 0xC ? PLIST_SET : PLIST_ARRAY);
-        const char *refs = ctx->buf + off + header;
-        for (uint64_t i = 0; i < count; i++) {
-            uint64_t ref = read_be_uint(refs + i * ctx->object_ref_size, ctx->object_ref_size);
-            plist_array_add(n, decode_object(ctx, ref));
+    default:
+        fprintf(stderr, "bplist: unknown object type marker 0x%02x at offset %zu\n", marker, off);
+        return plist_new(ctx->arena, PLIST_NULL);
+    }
+}
+
+/* Trees are decoded with an explicit stack rather than by recursion:
+   a frame per container being filled, holding where it has got to. */
+typedef struct {
+    PlistNode *node;
+    uint64_t index;   /* the container's object index */
+    const char *refs; /* its object references */
+    uint64_t count;
+    uint64_t next;
+    uint32_t height;  /* levels of containers in it so far, itself included */
+    bool cut;         /* something in it was nested too deeply, and decoded as null */
+    bool copy;        /* it's a copy of an object decoded already -- see node_for() */
+} DecodeFrame;
+
+/* Note what a child of the container on top of the stack is like below it. */
+static void add_child_shape(DecodeFrame *stack, size_t sp, uint32_t height, bool cut) {
+    if (sp == 0)
+        return;
+    DecodeFrame *parent = &stack[sp - 1];
+    if (parent->height < height + 1)
+        parent->height = height + 1;
+    parent->cut |= cut;
+}
+
+static bool plist_is_container(const PlistNode *n) {
+    return n->type == PLIST_DICT || n->type == PLIST_ARRAY || n->type == PLIST_SET;
+}
+
+/* Returns the node for object index. Binary plists are DAGs -- an
+   object can be referred to from many places -- so each is decoded
+   once and the node shared, and the cost is bounded by the number of
+   objects, not the number of references. A container comes back empty,
+   pushed onto the stack to be filled in.
+
+   max_depth applies to every path through the tree, so a container can
+   only be shared where it's cut short the same way: if it goes deeper
+   than there's room for where it's referred to again, or it was cut
+   short when decoded and there's more room here, a copy of it is
+   decoded for here. Copies are made afresh each time, so their object
+   references are counted against copy_budget, like the printers'
+   budget of nodes. */
+static PlistNode *node_for(TreeCtx *ctx, uint64_t index, DecodeFrame *stack, size_t *sp,
+                           size_t stack_size) {
+    PlistNode *n = ctx->decoded[index];
+    if (n == &decoding_in_progress) {
+        fprintf(stderr, "bplist: object %llu is part of a reference cycle\n", (unsigned long long)index);
+        return plist_new(ctx->arena, PLIST_NULL);
+    }
+    size_t room = stack_size - *sp;
+    if (n && !plist_is_container(n))
+        return n;
+    if (n) {
+        const DecodedShape *shape = &ctx->shapes[index];
+        if (shape->cut ? shape->height == room : shape->height <= room) {
+            add_child_shape(stack, *sp, shape->height, shape->cut);
+            return n;
         }
+    }
+    size_t off = object_offset(&ctx->bp, index);
+    uint8_t type = (uint8_t)ctx->bp.buf[off] >> 4;
+    if (type != 0xA && type != 0xC && type != 0xD) {
+        n = decode_scalar_at(ctx, off);
+        ctx->decoded[index] = n;
         return n;
     }
+    if (room == 0) {
+        fprintf(stderr, "bplist: objects nested more than %u deep\n", bplist_limits.max_depth);
+        stack[*sp - 1].cut = true;
+        return plist_new(ctx->arena, PLIST_NULL);
+    }
+    size_t header;
+    uint64_t count = read_size(ctx->bp.buf, off, &header);
+    bool copy = n != NULL;
+    if (copy) {
+        /* a copy's references to the containers it's in are cycles, as
+           they were when the object was first decoded */
+        for (size_t i = 0; i < *sp; i++)
+            if (stack[i].index == index) {
+                fprintf(stderr, "bplist: object %llu is part of a reference cycle\n",
+                        (unsigned long long)index);
+                return plist_new(ctx->arena, PLIST_NULL);
+            }
+        if (ctx->copy_budget <= count) {
+            fprintf(stderr, "bplist: too many objects shared at different depths\n");
+            stack[*sp - 1].cut = true;
+            return plist_new(ctx->arena, PLIST_NULL);
+        }
+        ctx->copy_budget -= count + 1;
+    }
+    if (type == 0xD)
+        n = plist_new_dict(ctx->arena, count);
+    else
+        n = plist_new_array_like(ctx->arena, type == 0xC ? PLIST_SET : PLIST_ARRAY, count);
+    if (!copy)
+        ctx->decoded[index] = &decoding_in_progress; /* until it's popped */
+    stack[*sp] = (DecodeFrame){ .node = n, .index = index, .refs = ctx->bp.buf + off + header,
+                                .count = count, .next = 0, .height = 1, .cut = false,
+                                .copy = copy };
+    (*sp)++;
+    return n;
+}
 
-    case 0xD: { /* dict: `count` key refs, then `count` value refs */
-        size_t header;
-        uint64_t count = read_size(ctx->buf, off, &header);
-        PlistNode *n = plist_new(PLIST_DICT);
-        const char *key_refs = ctx->buf + off + header;
-        const char *val_refs = key_refs + count * ctx->object_ref_size;
-        for (uint64_t i = 0; i < count; i++) {
-            uint64_t kref = read_be_uint(key_refs + i * ctx->object_ref_size, ctx->object_ref_size);
-            uint64_t vref = read_be_uint(val_refs + i * ctx->object_ref_size, ctx->object_ref_size);
-            PlistNode *key_node = decode_object(ctx, kref);
-            const char *key_str = (key_node->type == PLIST_STRING) ? key_node->v.string : "<non-string key>";
-            plist_dict_set(n, key_str, decode_object(ctx, vref));
-            plist_free(key_node);
+static PlistNode *decode_tree(TreeCtx *ctx) {
+    size_t stack_size = bplist_limits.max_depth;
+    if (stack_size > ctx->bp.num_objects) stack_size = ctx->bp.num_objects;
+    DecodeFrame *stack = arena_alloc(ctx->arena, stack_size * sizeof(DecodeFrame));
+    size_t sp = 0;
+    size_t rs = ctx->bp.object_ref_size;
+
+    PlistNode *root = node_for(ctx, ctx->bp.top_object, stack, &sp, stack_size);
+    while (sp > 0) {
+        DecodeFrame *f = &stack[sp - 1];
+        if (f->next == f->count) {
+            if (f->node->type == PLIST_DICT)
+                plist_dict_build_index(ctx->arena, f->node);
+            if (!f->copy) {
+                ctx->decoded[f->index] = f->node;
+                ctx->shapes[f->index] = (DecodedShape){ .height = f->height, .cut = f->cut };
+            }
+            sp--;
+            add_child_shape(stack, sp, f->height, f->cut);
+            continue;
+        }
+        uint64_t i = f->next++;
+        if (f->node->type == PLIST_DICT) { /* `count` key refs, then `count` value refs */
+            uint64_t kref = read_be_uint(f->refs + i * rs, rs);
+            uint64_t vref = read_be_uint(f->refs + (f->count + i) * rs, rs);
+            const char *key_str = "<non-string key>";
+            uint8_t ktype = (uint8_t)ctx->bp.buf[object_offset(&ctx->bp, kref)] >> 4;
+            if (ktype == 0x5 || ktype == 0x6) /* strings are never pushed */
+                key_str = node_for(ctx, kref, stack, &sp, stack_size)->v.string;
+            plist_dict_set(f->node, key_str, node_for(ctx, vref, stack, &sp, stack_size));
+        } else {
+            uint64_t ref = read_be_uint(f->refs + i * rs, rs);
+            plist_array_add(f->node, node_for(ctx, ref, stack, &sp, stack_size));
         }
-        return n;
     }
+    return root;
+}
 
-    default:
-        fprintf(stderr, "bplist: unknown object type marker 0x%02x at offset %zu\n", marker, off);
-        return plist_new(PLIST_NULL);
+/* A single pass over the offset table before anything is decoded: every
+   object must lie within the object table and be of a known type, every
+   reference must be in range, and the totals must be within the limits.
+   After this the decoder needs no checks of its own. */
+static int validate(const BplistCtx *ctx) {
+    if (ctx->num_objects > bplist_limits.max_objects) {
+        fprintf(stderr, "bplist: %llu objects, more than the limit of %llu\n",
+                (unsigned long long)ctx->num_objects, (unsigned long long)bplist_limits.max_objects);
+        return -1;
+    }
+    uint64_t decoded_bytes = 0;
+    size_t rs = ctx->object_ref_size;
+    for (uint64_t i = 0; i < ctx->num_objects; i++) {
+        BplistValue v;
+        if (bplist_value(ctx, i, &v) != 0) {
+            fprintf(stderr, "bplist: object %llu is malformed\n", (unsigned long long)i);
+            return -1;
+        }
+        switch (v.type) {
+        case PLIST_STRING:
+            decoded_bytes += v.utf16 ? v.length / 2 * 3 + 1 : v.length + 1;
+            break;
+        case PLIST_DATA:
+            decoded_bytes += v.length;
+            break;
+        case PLIST_DICT:
+        case PLIST_ARRAY:
+        case PLIST_SET: {
+            uint64_t refs = v.type == PLIST_DICT ? v.count * 2 : v.count;
+            for (uint64_t r = 0; r < refs; r++)
+                if (read_be_uint(v.bytes + r * rs, rs) >= ctx->num_objects) {
+                    fprintf(stderr, "bplist: object %llu refers to an object out of range\n",
+                            (unsigned long long)i);
+                    return -1;
+                }
+            decoded_bytes += v.count * (v.type == PLIST_DICT ? sizeof(PlistDictEntry) + 2 * sizeof(uint32_t)
+                                                             : sizeof(PlistNode *));
+            break;
+        }
+        default:
+            break;
+        }
     }
+    if (decoded_bytes > bplist_limits.max_decoded_bytes) {
+        fprintf(stderr, "bplist: %llu bytes when decoded, more than the limit of %llu\n",
+                (unsigned long long)decoded_bytes,
+                (unsigned long long)bplist_limits.max_decoded_bytes);
+        return -1;
+    }
+    return 0;
 }
 
-static PlistNode *decode_object(BplistCtx *ctx, uint64_t index) {
-    if (index >= ctx->num_objects) {
-        fprintf(stderr, "bplist: object index %llu out of range\n", (unsigned long long)index);
-        return plist_new(PLIST_NULL);
+/* Reads and checks the trailer. Returns 0 on success, or -1 if buf
+   doesn't hold a binary plist, with a message on stderr. */
+int bplist_open(BplistCtx *ctx, const char *buf, size_t len) {
+    if (len < 40 || memcmp(buf, "bplist00", 8) != 0) {
+        fprintf(stderr, "bplist: not a binary plist (bad magic or too short)\n");
+        return -1;
     }
-    return decode_at(ctx, object_offset(ctx, index));
+    const char *trailer = buf + len - 32;
+    memset(ctx, 0, sizeof(BplistCtx));
+    ctx->buf = buf;
+    ctx->len = len;
+    ctx->offset_size = trailer[6];
+    ctx->object_ref_size = trailer[7];
+    ctx->num_objects = read_be_uint(trailer + 8, 8);
+    ctx->top_object = read_be_uint(trailer + 16, 8);
+    ctx->offset_table_offset = read_be_uint(trailer + 24, 8);
+    if (ctx->offset_size < 1 || ctx->offset_size > 8 ||
+        ctx->object_ref_size < 1 || ctx->object_ref_size > 8 ||
+        ctx->offset_table_offset < 8 || ctx->offset_table_offset > len - 32 ||
+        ctx->num_objects > (len - 32 - ctx->offset_table_offset) / ctx->offset_size ||
+        ctx->top_object >= ctx->num_objects) {
+        fprintf(stderr, "bplist: bad trailer\n");
+        return -1;
+    }
+    ctx->offset_table = buf + ctx->offset_table_offset;
+    return 0;
 }
 
 /* Entry point: parse a binary plist held as a byte buffer in memory.
    Returns the root PlistNode, or NULL on failure (bad magic / truncated). */
 PlistNode *plist_parse_binary(const char *buf, size_t len) {
-    if (len < 40 || memcmp(buf, "bplist00", 8) != 0) {
-        fprintf(stderr, "bplist: not a binary plist (bad magic or too short)\n");
+    TreeCtx ctx;
+    if (bplist_open(&ctx.bp, buf, len) != 0 || validate(&ctx.bp) != 0)
         return NULL;
+
+    /* Size the first arena block for a node and a dict entry per object,
+       plus room for the strings and data copied out of the buffer and
+       the pointers that replace the object references. */
+    uint64_t objects = ctx.bp.num_objects < len ? ctx.bp.num_objects : len;
+    size_t estimate = sizeof(PlistDocument) + objects * (sizeof(PlistNode) + sizeof(PlistDictEntry) + sizeof(PlistNode *) + 32) + len * 2;
+    PlistArenaBlock *first = arena_block_new(estimate);
+    PlistDocument *doc = (PlistDocument *)first->data;
+    first->used = (sizeof(PlistDocument) + 15) & ~(size_t)15;
+    doc->arena.head = first;
+    ctx.arena = &doc->arena;
+    ctx.decoded = arena_alloc(ctx.arena, ctx.bp.num_objects * sizeof(PlistNode *));
+    memset(ctx.decoded, 0, ctx.bp.num_objects * sizeof(PlistNode *));
+    ctx.shapes = arena_alloc(ctx.arena, ctx.bp.num_objects * sizeof(DecodedShape));
+    ctx.copy_budget = bplist_limits.max_objects;
+
+    doc->root = *decode_tree(&ctx);
+    return &doc->root;
+}
+
+/* ---------- Lazy accessors ----------
+
+   These read values straight from the buffer without building a tree.
+   Only the objects along a key path are looked at, and strings and data
+   come back as pointers into the buffer, so they live as long as it does.
+   Unlike the tree builder, everything is bounds-checked. */
+
+static int sized_object(const BplistCtx *ctx, size_t off, size_t unit,
+                        size_t *out_header, uint64_t *out_count) {
+    size_t limit = ctx->offset_table_offset;
+    uint8_t info = (uint8_t)ctx->buf[off] & 0x0F;
+    size_t header = 1;
+    uint64_t count = info;
+    if (info == 0x0F) {
+        if (off + 2 > limit) return -1;
+        size_t int_bytes = (size_t)1 << ((uint8_t)ctx->buf[off + 1] & 0x0F);
+        if (int_bytes > 8 || off + 2 + int_bytes > limit) return -1;
+        count = read_be_uint(ctx->buf + off + 2, int_bytes);
+        header = 2 + int_bytes;
     }
+    if (count > (limit - off - header) / unit) return -1;
+    *out_header = header;
+    *out_count = count;
+    return 0;
+}
 
-    const char *trailer = buf + len - 32;
-    BplistCtx ctx = {
-        .buf = buf,
-        .len = len,
-        .offset_size      = trailer[6],
-        .object_ref_size  = trailer[7],
-        .num_objects      = read_be_uint(trailer + 8, 8),
-        .top_object       = read_be_uint(trailer + 16, 8),
-        .offset_table_offset = read_be_uint(trailer + 24, 8),
-    };
-    ctx.offset_table = buf + ctx.offset_table_offset;
+int bplist_value(const BplistCtx *ctx, uint64_t index, BplistValue *out) {
+    if (index >= ctx->num_objects) return -1;
+    uint64_t off = object_offset(ctx, index);
+    if (off < 8 || off >= ctx->offset_table_offset) return -1;
+    const char *p = ctx->buf + off;
+    uint8_t marker = (uint8_t)*p;
+    uint8_t info = marker & 0x0F;
+    size_t room = ctx->offset_table_offset - off - 1; /* bytes after the marker */
+    size_t header;
+    uint64_t count;
+
+    memset(out, 0, sizeof(BplistValue));
+    out->index = index;
+    switch (marker >> 4) {
+    case 0x0:
+        out->type = (marker == 0x08 || marker == 0x09) ? PLIST_BOOLEAN : PLIST_NULL;
+        out->v.boolean = (marker == 0x09);
+        return 0;
+    case 0x1:
+        if (((size_t)1 << info) > room || info > 4) return -1;
+        out->type = PLIST_INTEGER;
+        if (info >= 3) /* the low 64 bits, signed */
+            out->v.integer = (int64_t)read_be_uint(p + 1 + ((size_t)1 << info) - 8, 8);
+        else
+            out->v.integer = (int64_t)read_be_uint(p + 1, (size_t)1 << info);
+        return 0;
+    case 0x2:
+        if ((info != 2 && info != 3) || ((size_t)1 << info) > room) return -1;
+        out->type = PLIST_REAL;
+        out->v.real = read_be_float(p + 1, (size_t)1 << info);
+        return 0;
+    case 0x3:
+        if (room < 8) return -1;
+        out->type = PLIST_DATE;
+        out->v.date = read_be_float(p + 1, 8);
+        return 0;
+    case 0x4:
+    case 0x5:
+    case 0x6:
+        if (sized_object(ctx, off, (marker >> 4) == 0x6 ? 2 : 1, &header, &count) != 0) return -1;
+        out->type = (marker >> 4) == 0x4 ? PLIST_DATA : PLIST_STRING;
+        out->utf16 = (marker >> 4) == 0x6;
+        out->bytes = p + header;
+        out->length = out->utf16 ? count * 2 : count;
+        return 0;
+    case 0x8:
+        if ((size_t)info + 1 > room) return -1;
+        out->type = PLIST_UID;
+        out->v.uid = read_be_uint(p + 1, (size_t)info + 1);
+        return 0;
+    case 0xA:
+    case 0xC:
+    case 0xD:
+        if (sized_object(ctx, off, ((marker >> 4) == 0xD ? 2 : 1) * ctx->object_ref_size,
+                         &header, &count) != 0) return -1;
+        out->type = (marker >> 4) == 0xD ? PLIST_DICT : (marker >> 4) == 0xC ? PLIST_SET : PLIST_ARRAY;
+        out->bytes = p + header; /* the object references */
+        out->count = count;
+        return 0;
+    default:
+        return -1;
+    }
+}
 
-    return decode_object(&ctx, ctx.top_object);
+/* Compares a string object with a UTF-8 key of the given length. */
+static bool string_equals(const BplistValue *s, const char *key, size_t key_len) {
+    if (!s->utf16)
+        return s->length == key_len && memcmp(s->bytes, key, key_len) == 0;
+    size_t ki = 0;
+    for (size_t i = 0; i < s->length; i += 2) {
+        uint16_t cu = (uint16_t)read_be_uint(s->bytes + i, 2);
+        /* decode one BMP character from the key */
+        if (ki >= key_len) return false;
+        uint8_t c = (uint8_t)key[ki];
+        uint32_t kc;
+        size_t extra;
+        if (c < 0x80) { kc = c; extra = 0; }
+        else if ((c & 0xE0) == 0xC0) { kc = c & 0x1F; extra = 1; }
+        else if ((c & 0xF0) == 0xE0) { kc = c & 0x0F; extra = 2; }
+        else return false;
+        if (ki + 1 + extra > key_len) return false;
+        for (size_t j = 1; j <= extra; j++) kc = (kc << 6) | ((uint8_t)key[ki + j] & 0x3F);
+        ki += 1 + extra;
+        if (kc != cu) return false;
+    }
+    return ki == key_len;
+}
+
+int bplist_get(const BplistCtx *ctx, const BplistValue *container, const char *key,
+               size_t key_len, BplistValue *out) {
+    size_t rs = ctx->object_ref_size;
+    if (container->type == PLIST_DICT) {
+        const char *val_refs = container->bytes + container->count * rs;
+        for (uint64_t i = 0; i < container->count; i++) {
+            BplistValue k;
+            if (bplist_value(ctx, read_be_uint(container->bytes + i * rs, rs), &k) == 0 &&
+                k.type == PLIST_STRING && string_equals(&k, key, key_len))
+                return bplist_value(ctx, read_be_uint(val_refs + i * rs, rs), out);
+        }
+        return -1;
+    }
+    if (container->type == PLIST_ARRAY || container->type == PLIST_SET) {
+        uint64_t i = 0;
+        if (key_len == 0 || key_len > 18) return -1;
+        for (size_t j = 0; j < key_len; j++) {
+            if (key[j] < '0' || key[j] > '9') return -1;
+            i = i * 10 + (uint64_t)(key[j] - '0');
+        }
+        if (i >= container->count) return -1;
+        return bplist_value(ctx, read_be_uint(container->bytes + i * rs, rs), out);
+    }
+    return -1;
+}
+
+int bplist_lookup(const BplistCtx *ctx, const char *path, BplistValue *out) {
+    if (bplist_value(ctx, ctx->top_object, out) != 0) return -1;
+    while (*path) {
+        const char *slash = strchr(path, '/');
+        size_t seg_len = slash ? (size_t)(slash - path) : strlen(path);
+        BplistValue next;
+        if (bplist_get(ctx, out, path, seg_len, &next) != 0) return -1;
+        *out = next;
+        path += seg_len;
+        if (*path == '/') path++;
+    }
+    return 0;
 }
 
 // Utility -- give it a string of bytes and an indent depth
-// Warning: not proof against malformed data!
 
-int pretty_print_binary_plist(const char *buf, size_t size, int depth) {
+int fpretty_print_binary_plist(FILE *out, const char *buf, size_t size, int depth) {
+  if (depth > (int)bplist_limits.max_depth) {
+      indent(out, depth);
+      fputs("<nested too deeply>\n", out);
+      return EXIT_FAILURE;
+  }
+  PlistNode *root = plist_parse_binary(buf, (size_t)size);
+  if (root) {
+      indent(out, depth);
+      plist_fprint(out, root, depth);
+      plist_free(root);
+  }
+  return root ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int fprint_binary_plist_json(FILE *out, const char *buf, size_t size, int depth) {
+  if (depth > (int)bplist_limits.max_depth)
+      return EXIT_FAILURE;
   PlistNode *root = plist_parse_binary(buf, (size_t)size);
   if (root) {
-      indent(depth);
-      plist_print(root, depth);
+      plist_fprint_json(out, root, depth);
       plist_free(root);
   }
   return root ? EXIT_SUCCESS : EXIT_FAILURE;
-}
\ No newline at end of file
+}
+
+int pretty_print_binary_plist(const char *buf, size_t size, int depth) {
+  return fpretty_print_binary_plist(stdout, buf, size, depth);
+}
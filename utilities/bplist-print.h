@@ -1,7 +1,114 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    PLIST_DICT,
+    PLIST_ARRAY,
+    PLIST_SET,       /* rare; binary-plist-only container type */
+    PLIST_STRING,
+    PLIST_INTEGER,
+    PLIST_REAL,
+    PLIST_BOOLEAN,
+    PLIST_DATE,
+    PLIST_DATA,
+    PLIST_UID,       /* NSKeyedArchiver object reference */
+    PLIST_NULL
+} PlistType;
+
+typedef struct PlistNode PlistNode;
+
+typedef struct {
+    const char *buf;
+    size_t len;
+    uint8_t  offset_size;
+    uint8_t  object_ref_size;
+    uint64_t num_objects;
+    uint64_t top_object;
+    uint64_t offset_table_offset;
+    const char *offset_table; /* points into buf */
+} BplistCtx;
+
+// Limits on what plist_parse_binary() will decode. Plists beyond them are rejected
+// before anything is decoded; objects nested too deeply on any path through the tree,
+// including paths through objects shared by more than one container, are decoded as null.
+typedef struct {
+    unsigned max_depth;         /* nesting of dicts, arrays and sets */
+    uint64_t max_objects;       /* objects in the offset table */
+    uint64_t max_decoded_bytes; /* strings, data and container contents, once decoded */
+} BplistLimits;
+
+#define BPLIST_DEFAULT_MAX_DEPTH 256
+#define BPLIST_DEFAULT_MAX_OBJECTS (1024 * 1024)
+#define BPLIST_DEFAULT_MAX_DECODED_BYTES (64 * 1024 * 1024)
+
+void bplist_set_limits(const BplistLimits *limits);
+void bplist_get_limits(BplistLimits *limits);
+
+// Check the trailer of the binary plist in buf and set up ctx to read it.
+// Returns 0 on success or -1 if it isn't a binary plist.
+int bplist_open(BplistCtx *ctx, const char *buf, size_t len);
+
+// A value read straight from the buffer, without decoding anything else.
+// Strings and data are borrowed from the buffer -- strings are not NUL-terminated
+// and are UTF-16BE if utf16 is set. For containers, bytes points at the object references.
+typedef struct {
+    PlistType type;
+    uint64_t index;     /* the object's index */
+    const char *bytes;  /* PLIST_STRING, PLIST_DATA */
+    size_t length;      /* in bytes */
+    bool utf16;
+    uint64_t count;     /* PLIST_DICT (pairs), PLIST_ARRAY, PLIST_SET */
+    union {
+        int64_t  integer;
+        double   real;
+        bool     boolean;
+        double   date;  /* seconds since 2001-01-01T00:00:00Z */
+        uint64_t uid;
+    } v;
+} BplistValue;
+
+// Read object number index. Returns 0 on success, -1 if it's malformed.
+int bplist_value(const BplistCtx *ctx, uint64_t index, BplistValue *out);
+
+// Look up a key in a dict, or a decimal index in an array or set.
+// Returns 0 if found, -1 otherwise.
+int bplist_get(const BplistCtx *ctx, const BplistValue *container, const char *key,
+               size_t key_len, BplistValue *out);
+
+// Resolve a '/'-separated path of keys and indices from the root object,
+// e.g. "params/kMRMediaRemoteNowPlayingInfoTitle". Only the objects on the path are read.
+// Returns 0 if found, -1 otherwise.
+int bplist_lookup(const BplistCtx *ctx, const char *path, BplistValue *out);
+
+// Parse a binary plist held as a byte buffer in memory.
+// Returns the root of a tree of PlistNode, or NULL on failure (bad magic / truncated).
+// The whole tree is held in one arena -- free it with plist_free(root).
+PlistNode *plist_parse_binary(const char *buf, size_t len);
+
+// Free a tree returned by plist_parse_binary(). Pass the root only.
+void plist_free(PlistNode *root);
+
+// Look up a key in a PLIST_DICT node. Returns NULL if it's not there.
+// Big dicts are hash-indexed; small ones are scanned.
+PlistNode *plist_dict_get(const PlistNode *dict, const char *key);
+
+// Print a tree at an indent depth.
+void plist_fprint(FILE *out, const PlistNode *node, int depth);
+void plist_print(const PlistNode *node, int depth);
+
+// Print a tree as compact JSON, on one line. depth is how deeply it's nested already, e.g. in
+// a Data node of another plist, which counts towards the depth limit.
+void plist_fprint_json(FILE *out, const PlistNode *node, int depth);
+
 // Utility -- give it a string of bytes containing a binary plist
-// and an indent depth.
-// Warning: not proof against malformed data!
+// and an indent depth. Malformed plists are rejected with a message on stderr.
+
+int pretty_print_binary_plist(const char *buf, size_t size, int depth);
+int fpretty_print_binary_plist(FILE *out, const char *buf, size_t size, int depth);
 
-int pretty_print_binary_plist(const char *buf, size_t size, int depth);
\ No newline at end of file
+// The same, printing it as JSON with plist_fprint_json(). Nothing is printed if it's malformed.
+int fprint_binary_plist_json(FILE *out, const char *buf, size_t size, int depth);
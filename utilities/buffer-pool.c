@@ -0,0 +1,153 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "buffer-pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// size classes are powers of two from 2^BUFFER_POOL_MIN_SHIFT to 2^BUFFER_POOL_MAX_SHIFT bytes;
+// anything bigger is allocated and freed directly.
+#define BUFFER_POOL_MIN_SHIFT 8
+#define BUFFER_POOL_MAX_SHIFT 24
+#define BUFFER_POOL_CLASSES (BUFFER_POOL_MAX_SHIFT - BUFFER_POOL_MIN_SHIFT + 1)
+
+// a free buffer holds the link to the next free buffer of its class
+typedef struct FreeBuffer {
+  struct FreeBuffer *next;
+} FreeBuffer;
+
+typedef struct {
+  FreeBuffer *head;
+  size_t count;
+  int used; // acquired from since the last trim
+} SizeClass;
+
+static SizeClass size_classes[BUFFER_POOL_CLASSES];
+static BufferPoolStats pool_stats;
+static uint64_t acquisitions_since_trim;
+
+// always lock this when accessing size_classes or pool_stats
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int size_class_of(size_t size) {
+  int shift = BUFFER_POOL_MIN_SHIFT;
+  while ((shift <= BUFFER_POOL_MAX_SHIFT) && (((size_t)1 << shift) < size))
+    shift++;
+  return shift - BUFFER_POOL_MIN_SHIFT; // BUFFER_POOL_CLASSES if it's too big for the pool
+}
+
+static void free_class(SizeClass *sc, size_t class_size) {
+  while (sc->head) {
+    FreeBuffer *next = sc->head->next;
+    free(sc->head);
+    sc->head = next;
+    pool_stats.bytes_cached -= class_size;
+    pool_stats.trimmed++;
+  }
+  sc->count = 0;
+}
+
+// free the cached buffers of size classes that haven't been asked for since the last trim
+static void trim_idle_classes(void) {
+  for (int i = 0; i < BUFFER_POOL_CLASSES; i++) {
+    if (size_classes[i].used == 0)
+      free_class(&size_classes[i], (size_t)1 << (i + BUFFER_POOL_MIN_SHIFT));
+    size_classes[i].used = 0;
+  }
+  acquisitions_since_trim = 0;
+}
+
+void *buffer_pool_acquire(size_t size, size_t *actual_size) {
+  int class = size_class_of(size);
+  size_t class_size = class < BUFFER_POOL_CLASSES ? (size_t)1 << (class + BUFFER_POOL_MIN_SHIFT)
+                                                  : size;
+  void *buf = NULL;
+  pthread_mutex_lock(&pool_lock);
+  if (class < BUFFER_POOL_CLASSES) {
+    SizeClass *sc = &size_classes[class];
+    sc->used = 1;
+    if (sc->head) {
+      buf = sc->head;
+      sc->head = sc->head->next;
+      sc->count--;
+      pool_stats.bytes_cached -= class_size;
+    }
+  }
+  if (buf)
+    pool_stats.hits++;
+  else
+    pool_stats.misses++;
+  pool_stats.bytes_in_use += class_size;
+  if (pool_stats.bytes_in_use > pool_stats.peak_bytes_in_use)
+    pool_stats.peak_bytes_in_use = pool_stats.bytes_in_use;
+  if (++acquisitions_since_trim >= BUFFER_POOL_TRIM_INTERVAL)
+    trim_idle_classes();
+  pthread_mutex_unlock(&pool_lock);
+  if (buf == NULL) {
+    buf = malloc(class_size);
+    if (buf == NULL)
+      die("could not allocate a buffer of %zu bytes", class_size);
+  }
+  *actual_size = class_size;
+  return buf;
+}
+
+void buffer_pool_release(void *buf, size_t actual_size) {
+  if (buf == NULL)
+    return;
+  int class = size_class_of(actual_size);
+  pthread_mutex_lock(&pool_lock);
+  pool_stats.releases++;
+  pool_stats.bytes_in_use -= actual_size;
+  if ((class < BUFFER_POOL_CLASSES) &&
+      (pool_stats.bytes_cached + actual_size <= BUFFER_POOL_MAX_CACHED_BYTES)) {
+    SizeClass *sc = &size_classes[class];
+    FreeBuffer *fb = buf;
+    fb->next = sc->head;
+    sc->head = fb;
+    sc->count++;
+    pool_stats.bytes_cached += actual_size;
+    if (pool_stats.bytes_cached > pool_stats.peak_bytes_cached)
+      pool_stats.peak_bytes_cached = pool_stats.bytes_cached;
+    buf = NULL;
+  } else if (class < BUFFER_POOL_CLASSES) {
+    pool_stats.trimmed++;
+  }
+  pthread_mutex_unlock(&pool_lock);
+  free(buf); // if it wasn't kept
+}
+
+void buffer_pool_trim(void) {
+  pthread_mutex_lock(&pool_lock);
+  for (int i = 0; i < BUFFER_POOL_CLASSES; i++)
+    free_class(&size_classes[i], (size_t)1 << (i + BUFFER_POOL_MIN_SHIFT));
+  pthread_mutex_unlock(&pool_lock);
+}
+
+void buffer_pool_get_stats(BufferPoolStats *stats) {
+  pthread_mutex_lock(&pool_lock);
+  memcpy(stats, &pool_stats, sizeof(BufferPoolStats));
+  pthread_mutex_unlock(&pool_lock);
+}
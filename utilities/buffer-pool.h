@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A pool of reusable buffers, in power-of-two size classes, to save a malloc() and free()
+// for every item. Buffers are returned to the pool when released and handed out again by
+// the next request for that size class. The pool is thread-safe.
+//
+// To stop the pool holding on to memory it no longer needs, it caches at most
+// BUFFER_POOL_MAX_CACHED_BYTES, and every BUFFER_POOL_TRIM_INTERVAL acquisitions it frees the
+// cached buffers in any size class that hasn't been asked for since the last time.
+
+#define BUFFER_POOL_MAX_CACHED_BYTES (4 * 1024 * 1024)
+#define BUFFER_POOL_TRIM_INTERVAL 4096
+
+typedef struct {
+  uint64_t hits;            // acquisitions satisfied from the pool
+  uint64_t misses;          // acquisitions that needed a malloc()
+  uint64_t releases;        // buffers given back
+  uint64_t trimmed;         // cached buffers freed by the trim policy or the cache limit
+  size_t bytes_in_use;      // handed out and not yet released
+  size_t peak_bytes_in_use; // the high-water mark of bytes_in_use
+  size_t bytes_cached;      // held in the pool, ready for reuse
+  size_t peak_bytes_cached;
+} BufferPoolStats;
+
+// Returns a buffer of at least size bytes; its actual size is returned in *actual_size.
+// Never returns NULL -- it dies if memory can't be allocated.
+void *buffer_pool_acquire(size_t size, size_t *actual_size);
+
+// Give back a buffer, passing the actual size returned when it was acquired.
+void buffer_pool_release(void *buf, size_t actual_size);
+
+// Free every buffer cached in the pool.
+void buffer_pool_trim(void);
+
+void buffer_pool_get_stats(BufferPoolStats *stats);
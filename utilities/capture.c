@@ -0,0 +1,315 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#define _GNU_SOURCE // for pipe2() and F_SETPIPE_SZ
+#include "capture.h"
+#include "clock.h"
+#include "item-handlers.h"
+#include "metadata-record.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CAPTURE_REPLAY_BATCH (64 * 1024) // the most written to the pipe at a time
+
+// Recording
+
+static FILE *capture;
+static uint64_t capture_offset; // of the next record
+static uint64_t raw_records;
+static uint64_t last_index; // the offset of the last index record written, 0 if none
+static MetadataRecordIndexEntry index_entries[METADATA_RECORD_INDEX_INTERVAL /
+                                              METADATA_RECORD_INDEX_STRIDE]; // little-endian
+static uint32_t index_count;
+
+typedef struct {
+  const void *data;
+  size_t length;
+} Part;
+
+// Write a record whose payload is made of parts.
+static void write_record(MetadataRecordHeader *header, const Part *parts, int count) {
+  static const char padding[METADATA_RECORD_ALIGNMENT] = {0};
+  size_t length = 0;
+  for (int i = 0; i < count; i++)
+    length += parts[i].length;
+  header->payload_length = length;
+  MetadataRecordHeader le = metadata_record_header_to_le(header);
+  fwrite(&le, sizeof(MetadataRecordHeader), 1, capture);
+  for (int i = 0; i < count; i++)
+    fwrite(parts[i].data, 1, parts[i].length, capture);
+  size_t size = metadata_record_size(length);
+  fwrite(padding, 1, size - sizeof(MetadataRecordHeader) - length, capture);
+  capture_offset += size;
+}
+
+static void write_index(void) {
+  MetadataRecordIndex index = {.previous = htole64(last_index),
+                               .count = htole32(index_count),
+                               .stride = htole32(METADATA_RECORD_INDEX_STRIDE)};
+  Part parts[] = {{&index, sizeof(index)},
+                  {index_entries, index_count * sizeof(MetadataRecordIndexEntry)}};
+  MetadataRecordHeader header = {.flags = METADATA_RECORD_INDEX, .received_ns = monotonic_ns()};
+  last_index = capture_offset;
+  write_record(&header, parts, 2);
+  index_count = 0;
+  fflush(capture);
+}
+
+void capture_record_open(const char *path) {
+  capture = fopen(path, "we");
+  if (capture == NULL)
+    die("could not create the capture file \"%s\": %s", path, strerror(errno));
+  metadata_record_write_stream_header(capture);
+  capture_offset = sizeof(MetadataRecordStreamHeader);
+}
+
+void capture_record_item(MetadataParserStatus status, const MetadataItem *item) {
+  static const char data_open[] = "\n<data encoding=\"base64\">\n";
+  static const char data_close[] = "</data></item>\n";
+  MetadataRecordHeader header = {.type = item->type,
+                                 .code = item->code,
+                                 .flags = METADATA_RECORD_RAW,
+                                 .sequence = item->sequence,
+                                 .received_ns = item->received_ns};
+  char tags[96];
+  Part parts[4];
+  int count = 0;
+  if (status == METADATA_PARSER_JUNK) {
+    header.flags |= METADATA_RECORD_JUNK;
+    parts[count++] = (Part){item->data, item->data_length};
+  } else {
+    // put the item back together as it was sent
+    int n = snprintf(tags, sizeof(tags),
+                     "<item><type>%08" PRIx32 "</type><code>%08" PRIx32 "</code><length>%zu"
+                     "</length>%s",
+                     item->type, item->code, item->length, item->data ? "" : "</item>\n");
+    parts[count++] = (Part){tags, n};
+    if (item->data) {
+      parts[count++] = (Part){data_open, strlen(data_open)};
+      parts[count++] = (Part){item->data, item->data_length};
+      if (item->flags & METADATA_ITEM_NO_END_TAG)
+        parts[count++] = (Part){"\n", 1};
+      else
+        parts[count++] = (Part){data_close, strlen(data_close)};
+    }
+  }
+  if ((raw_records % METADATA_RECORD_INDEX_STRIDE) == 0)
+    index_entries[index_count++] =
+        (MetadataRecordIndexEntry){.received_ns = htole64(item->received_ns),
+                                   .offset = htole64(capture_offset)};
+  write_record(&header, parts, count);
+  if ((++raw_records % METADATA_RECORD_INDEX_INTERVAL) == 0) {
+    write_index();
+  } else if (status == METADATA_PARSER_ITEM) {
+    // so that a capture is never far behind, e.g. when the player is killed
+    const ItemHandler *handler = item_handler_lookup(item->type, item->code);
+    if (handler && (handler->flags & ITEM_HANDLER_BOUNDARY))
+      fflush(capture);
+  }
+}
+
+void capture_record_close(void) {
+  if (capture == NULL)
+    return;
+  if ((index_count > 0) || (last_index == 0))
+    write_index();
+  MetadataRecordHeader header = {.flags = METADATA_RECORD_END, .received_ns = monotonic_ns()};
+  uint64_t end = htole64(last_index);
+  Part part = {&end, sizeof(end)};
+  write_record(&header, &part, 1);
+  if (fclose(capture) != 0)
+    warn("could not finish the capture file: %s", strerror(errno));
+  capture = NULL;
+}
+
+// Replaying
+
+static MetadataRecordReader replay;
+static int replay_fd = -1; // the write end of the pipe
+static int replay_realtime;
+static pthread_t replay_thread;
+static uint64_t replay_started_ns;
+static uint64_t replay_records, replay_bytes;
+
+// Returns 1 if offset, taken from the capture, could be that of a record in it.
+static int valid_offset(const MetadataRecordReader *r, uint64_t offset) {
+  return (offset >= sizeof(MetadataRecordStreamHeader)) && (offset < r->length) &&
+         ((offset % METADATA_RECORD_ALIGNMENT) == 0);
+}
+
+// Returns the offset of the first raw record received at or after start_ns, using the index if
+// the capture has one, otherwise by stepping through the records. Nothing read from the capture
+// is trusted -- an index that doesn't make sense is ignored.
+static size_t find_start(uint64_t start_ns) {
+  MetadataRecordReader r = replay;
+  const MetadataRecordHeader *h;
+  const unsigned char *payload;
+  size_t end_size = metadata_record_size(sizeof(uint64_t));
+  if (r.length >= sizeof(MetadataRecordStreamHeader) + end_size) {
+    h = (const MetadataRecordHeader *)(r.data + r.length - end_size);
+    uint64_t index_offset = 0;
+    if ((metadata_record_flags(h) & METADATA_RECORD_END) &&
+        (metadata_record_payload_length(h) == sizeof(uint64_t))) {
+      memcpy(&index_offset, h + 1, sizeof(uint64_t));
+      index_offset = le64toh(index_offset);
+    }
+    // follow the index records back to the one covering start_ns
+    while (valid_offset(&r, index_offset) &&
+           (r.length - index_offset >= sizeof(MetadataRecordHeader) + sizeof(MetadataRecordIndex))) {
+      h = (const MetadataRecordHeader *)(r.data + index_offset);
+      const MetadataRecordIndex *index = (const MetadataRecordIndex *)(h + 1);
+      const MetadataRecordIndexEntry *entries = (const MetadataRecordIndexEntry *)(index + 1);
+      uint32_t length = metadata_record_payload_length(h);
+      uint32_t count = metadata_record_index_count(index);
+      if (!(metadata_record_flags(h) & METADATA_RECORD_INDEX) ||
+          (metadata_record_size(length) > r.length - index_offset) ||
+          (length < sizeof(MetadataRecordIndex)) ||
+          (count > (length - sizeof(MetadataRecordIndex)) / sizeof(MetadataRecordIndexEntry)))
+        break;
+      if ((count > 0) && (metadata_record_entry_received_ns(&entries[0]) <= start_ns)) {
+        uint32_t i = count - 1;
+        while (metadata_record_entry_received_ns(&entries[i]) > start_ns)
+          i--;
+        if (valid_offset(&r, metadata_record_entry_offset(&entries[i])))
+          r.offset = metadata_record_entry_offset(&entries[i]);
+        break;
+      }
+      if (metadata_record_index_previous(index) >= index_offset)
+        break; // they should only go backwards
+      index_offset = metadata_record_index_previous(index);
+    }
+  }
+  size_t offset;
+  do {
+    offset = r.offset;
+    h = metadata_record_next(&r, &payload);
+  } while (h && (!(metadata_record_flags(h) & METADATA_RECORD_RAW) ||
+                 (metadata_record_received_ns(h) < start_ns)));
+  return offset;
+}
+
+static void write_all(const char *p, size_t length) {
+  while (length > 0) {
+    ssize_t n = write(replay_fd, p, length);
+    if ((n < 0) && (errno == EINTR))
+      continue;
+    if (n < 0)
+      return; // the reader has gone
+    p += n;
+    length -= n;
+  }
+}
+
+static void *replay_thread_function(__attribute__((unused)) void *arg) {
+  char *batch = malloc(CAPTURE_REPLAY_BATCH);
+  if (batch == NULL)
+    die("could not allocate the replay buffer");
+  size_t used = 0;
+  const MetadataRecordHeader *h;
+  const unsigned char *payload;
+  uint64_t first_ns = 0;
+  while ((h = metadata_record_next(&replay, &payload)) != NULL) {
+    if (!(metadata_record_flags(h) & METADATA_RECORD_RAW))
+      continue;
+    uint32_t length = metadata_record_payload_length(h);
+    if (replay_realtime) {
+      if (replay_records == 0)
+        first_ns = metadata_record_received_ns(h);
+      uint64_t due = replay_started_ns + (metadata_record_received_ns(h) - first_ns);
+      if (due > monotonic_ns()) {
+        write_all(batch, used);
+        used = 0;
+        struct timespec ts = {.tv_sec = due / 1000000000, .tv_nsec = due % 1000000000};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+          ;
+      }
+    }
+    if (used + length > CAPTURE_REPLAY_BATCH) {
+      write_all(batch, used);
+      used = 0;
+    }
+    if (length > CAPTURE_REPLAY_BATCH) {
+      write_all((const char *)payload, length);
+    } else {
+      memcpy(batch + used, payload, length);
+      used += length;
+    }
+    replay_records++;
+    replay_bytes += length;
+  }
+  write_all(batch, used);
+  free(batch);
+  if (replay.truncated)
+    warn("the capture ends part of the way through a record");
+  close(replay_fd); // the reader sees the end of its input
+  return NULL;
+}
+
+void capture_replay_start(const char *path, int realtime, double start_seconds) {
+  if (metadata_record_reader_map(&replay, path) != 0)
+    die("could not replay \"%s\": %s", path,
+        errno == EINVAL ? "it isn't a capture file" : strerror(errno));
+  if (start_seconds > 0) {
+    // times are relative to the first raw record
+    MetadataRecordReader r = replay;
+    const MetadataRecordHeader *h;
+    const unsigned char *payload;
+    while (((h = metadata_record_next(&r, &payload)) != NULL) &&
+           !(metadata_record_flags(h) & METADATA_RECORD_RAW))
+      ;
+    if (h)
+      replay.offset =
+          find_start(metadata_record_received_ns(h) + (uint64_t)(start_seconds * 1e9));
+  }
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0)
+    die("could not make a pipe to replay through: %s", strerror(errno));
+  fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024); // fewer context switches, if it's allowed
+  if (dup2(fds[0], STDIN_FILENO) < 0)
+    die("could not replay through standard input: %s", strerror(errno));
+  close(fds[0]);
+  replay_fd = fds[1];
+  replay_realtime = realtime;
+  replay_started_ns = monotonic_ns();
+  if (pthread_create(&replay_thread, NULL, replay_thread_function, NULL) != 0)
+    die("could not start the replay thread");
+}
+
+void capture_replay_finish(void) {
+  if (replay_fd < 0)
+    return;
+  pthread_join(replay_thread, NULL);
+  double seconds = (monotonic_ns() - replay_started_ns) / 1e9;
+  inform("replayed %" PRIu64 " items, %.1f MB, in %.3f s: %.0f items/s, %.1f MB/s.",
+         replay_records, replay_bytes / 1e6, seconds, replay_records / seconds,
+         replay_bytes / 1e6 / seconds);
+  metadata_record_reader_free(&replay);
+  replay_fd = -1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "metadata-parser.h"
+
+// Capture files, to record the metadata a player sends and replay it later, e.g. to debug a
+// problem seen in production. A capture is a stream of records, as defined in
+// metadata-record.h, holding each item or junk line as it was read and when it arrived, with an
+// index for finding a point in it quickly.
+
+// Start recording to the file at path, replacing it if it exists. Dies on error.
+void capture_record_open(const char *path);
+
+// Record an item or junk line returned by the parser. Use it as the parser's after_item hook.
+void capture_record_item(MetadataParserStatus status, const MetadataItem *item);
+
+// Finish the capture with its last index and end record, and close it.
+void capture_record_close(void);
+
+// Replay the capture at path, from start_seconds into it, as standard input -- which becomes a
+// pipe written to by a thread. If realtime is set, the items are written with the gaps between
+// them that there were when they were recorded, otherwise as fast as they can be read.
+// Dies on error.
+void capture_replay_start(const char *path, int realtime, double start_seconds);
+
+// Wait for the replay to finish and report, on stderr, how long it took.
+void capture_replay_finish(void);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// The time on the CLOCK_MONOTONIC clock, in nanoseconds, which all the timestamps are taken from.
+static inline uint64_t monotonic_ns(void) {
+  struct timespec tn;
+  clock_gettime(CLOCK_MONOTONIC, &tn);
+  return (uint64_t)tn.tv_sec * 1000000000 + tn.tv_nsec;
+}
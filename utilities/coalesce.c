@@ -0,0 +1,211 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "coalesce.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct QueueEntry {
+  struct QueueEntry *next;
+  char *text;
+  size_t length;
+} QueueEntry;
+
+typedef struct {
+  uint32_t type;
+  uint32_t code;
+  QueueEntry *entry; // the latest output of this type and code, since the last barrier
+} Slot;
+
+static int out_fd = STDOUT_FILENO;
+static QueueEntry *head = NULL, *tail = NULL;
+static size_t head_written = 0; // bytes of the head entry already written
+static Slot slots[COALESCE_SLOTS];
+static int slot_count = 0;
+static uint64_t coalesced = 0; // outputs replaced by newer ones
+
+static char *text = NULL;
+static size_t text_length = 0;
+static FILE *item_stream = NULL;
+
+// items whose output only matters until the next of the same type and code
+static int is_state(uint32_t type, uint32_t code) {
+  if (type == 'core')
+    return 1;
+  if (type != 'ssnc')
+    return 0;
+  switch (code) {
+  case 'phbt':
+  case 'phb0':
+  case 'prgr':
+  case 'pvol':
+  case 'mdst':
+  case 'mden':
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+int coalesce_init(void) {
+  struct stat st;
+  if (fstat(STDOUT_FILENO, &st) != 0)
+    die("could not examine standard output: %s", strerror(errno));
+  if (S_ISFIFO(st.st_mode)) {
+    // opened again, so that being non-blocking doesn't affect anything else sharing it
+    out_fd = open("/proc/self/fd/1", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (out_fd < 0)
+      die("could not open standard output for non-blocking writes: %s", strerror(errno));
+  } else if (S_ISSOCK(st.st_mode)) {
+    // a socket can't be opened again, but it's unlikely to be shared
+    int flags = fcntl(STDOUT_FILENO, F_GETFL);
+    if ((flags < 0) || (fcntl(STDOUT_FILENO, F_SETFL, flags | O_NONBLOCK) != 0))
+      die("could not make standard output non-blocking: %s", strerror(errno));
+  } else {
+    return 0;
+  }
+  item_stream = open_memstream(&text, &text_length);
+  if (item_stream == NULL)
+    die("could not open a memory stream: %s", strerror(errno));
+  return 1;
+}
+
+FILE *coalesce_stream(void) { return item_stream; }
+
+// Write out as much of the queue as can be written without blocking. Returns 1 if it's empty.
+static int drain(void) {
+  while (head) {
+    ssize_t n = write(out_fd, head->text + head_written, head->length - head_written);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN)
+        return 0;
+      die("error writing the output: %s", strerror(errno));
+    }
+    head_written += n;
+    if (head_written < head->length)
+      continue;
+    QueueEntry *done = head;
+    head = head->next;
+    if (head == NULL)
+      tail = NULL;
+    head_written = 0;
+    // if it's in a slot, it can't be replaced any more
+    for (int i = 0; i < slot_count; i++)
+      if (slots[i].entry == done)
+        slots[i].entry = NULL;
+    free(done->text);
+    free(done);
+  }
+  return 1;
+}
+
+// Returns the slot for the type and code, adding one if there's room, or NULL if there isn't.
+static Slot *slot_for(uint32_t type, uint32_t code) {
+  for (int i = 0; i < slot_count; i++)
+    if ((slots[i].type == type) && (slots[i].code == code))
+      return &slots[i];
+  if (slot_count == COALESCE_SLOTS)
+    return NULL;
+  Slot *slot = &slots[slot_count++];
+  slot->type = type;
+  slot->code = code;
+  slot->entry = NULL;
+  return slot;
+}
+
+static QueueEntry *enqueue(char *text_copy, size_t length) {
+  QueueEntry *entry = malloc(sizeof(QueueEntry));
+  if (entry == NULL)
+    die("could not allocate an output queue entry");
+  entry->next = NULL;
+  entry->text = text_copy;
+  entry->length = length;
+  if (tail)
+    tail->next = entry;
+  else
+    head = entry;
+  tail = entry;
+  return entry;
+}
+
+void coalesce_item_done(MetadataParserStatus status, const MetadataItem *item) {
+  fflush(item_stream); // which sets text and text_length
+  size_t length = text_length;
+  fseeko(item_stream, 0, SEEK_SET);
+  if (length == 0)
+    return;
+  char *copy = malloc(length);
+  if (copy == NULL)
+    die("could not allocate %zu bytes of output", length);
+  memcpy(copy, text, length);
+  if ((status == METADATA_PARSER_ITEM) && is_state(item->type, item->code)) {
+    Slot *slot = slot_for(item->type, item->code);
+    // replace the output that's waiting, unless part of it has been written already
+    if (slot && slot->entry && !((slot->entry == head) && (head_written > 0))) {
+      free(slot->entry->text);
+      slot->entry->text = copy;
+      slot->entry->length = length;
+      coalesced++;
+    } else {
+      QueueEntry *entry = enqueue(copy, length);
+      if (slot)
+        slot->entry = entry;
+    }
+  } else {
+    slot_count = 0; // a barrier -- nothing before it can be replaced
+    enqueue(copy, length);
+  }
+  drain();
+}
+
+void coalesce_wait_for_input(int fd) {
+  while (!drain()) {
+    struct pollfd pfd[2] = {{.fd = fd, .events = POLLIN}, {.fd = out_fd, .events = POLLOUT}};
+    if (poll(pfd, 2, -1) < 0) {
+      if (errno == EINTR)
+        return; // let the caller see to the signal
+      die("poll failed: %s", strerror(errno));
+    }
+    if (pfd[0].revents)
+      return; // input has arrived
+  }
+}
+
+void coalesce_flush(void) {
+  while (!drain()) {
+    struct pollfd pfd = {.fd = out_fd, .events = POLLOUT};
+    if ((poll(&pfd, 1, -1) < 0) && (errno != EINTR))
+      die("poll failed: %s", strerror(errno));
+  }
+  if (coalesced)
+    debug(1, "%llu items' output was replaced by newer output before being written",
+          (unsigned long long)coalesced);
+}
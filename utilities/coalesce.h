@@ -0,0 +1,38 @@
+#pragma once
+
+#include "metadata-parser.h"
+
+// Latest-value-wins output, for a consumer that can fall behind -- e.g. a slow display driver.
+// Ordinarily, when the consumer stops reading, the reader blocks writing to it, stops reading
+// the metadata pipe and, in the end, holds up Shairport Sync.
+//
+// Instead, each item's output is queued and written out without blocking. While the consumer
+// isn't taking it, the queue grows, but an item that just updates some state -- phbt, prgr,
+// pvol, phb0, the mdst and mden markers and the core fields of a metadata bundle -- replaces the
+// output of an earlier item with the same type and code still waiting in the queue, found
+// through a small table of slots keyed by type and code. Other items, including events like
+// pbeg, pend, paus and clip, are never dropped. They also act as barriers: nothing queued
+// before one is replaced by anything after it, so the output is never reordered around them.
+//
+// This only works if standard output is a pipe, a FIFO or a socket, which a consumer can fall
+// behind in reading.
+
+#define COALESCE_SLOTS 64 // the most different types and codes coalesced between two barriers
+
+// Set up standard output for non-blocking writes. Returns 0 if it isn't a pipe, a FIFO or a
+// socket, in which case it should be written to as usual. Dies on error.
+int coalesce_init(void);
+
+// The stream an item is to be formatted to.
+FILE *coalesce_stream(void);
+
+// Queue what's been formatted to the stream for the item and try to write out the queue.
+void coalesce_item_done(MetadataParserStatus status, const MetadataItem *item);
+
+// The parser's before_read hook: until there's input on fd, keep writing out the queue as the
+// consumer takes it.
+void coalesce_wait_for_input(int fd);
+
+// Write out everything that's queued, waiting for the consumer if need be, e.g. at the end of
+// the input.
+void coalesce_flush(void);
@@ -0,0 +1,192 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#define _GNU_SOURCE // for memmem()
+#include "dump-file.h"
+#include "buffer-pool.h"
+#include "output.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+  size_t start, end; // offsets in the file
+  FILE *out;
+  char *text; // the output, once it's done
+  size_t text_length;
+  int done;
+} Chunk;
+
+typedef struct {
+  char *data;
+  Chunk *chunks;
+  int count;
+  ItemFormatFunction format;
+  int unordered;
+  int window;  // the most chunks started but not yet written out
+  int next;    // the next chunk to start
+  int written; // chunks written out -- in ordered mode, all those before this one
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+} DumpFile;
+
+// Returns the offset of the first item at or after offset that can start a chunk.
+static size_t find_chunk_start(const char *data, size_t length, size_t offset) {
+  // an item header right after the end of another item, so the chunk before it ends cleanly
+  static const char boundary[] = "</item>\n<item><type>";
+  const char *p = memmem(data + offset, length - offset, boundary, sizeof(boundary) - 1);
+  return p ? (size_t)(p - data) + strlen("</item>\n") : length;
+}
+
+static void write_chunk(Chunk *chunk) {
+  fwrite(chunk->text, 1, chunk->text_length, stdout);
+  free(chunk->text);
+  chunk->text = NULL;
+}
+
+static void process_chunk(DumpFile *df, Chunk *chunk) {
+  MetadataParser parser;
+  metadata_parser_init_buffer(&parser, df->data + chunk->start, chunk->end - chunk->start);
+  chunk->out = open_memstream(&chunk->text, &chunk->text_length);
+  if (chunk->out == NULL)
+    die("could not open a memory stream: %s", strerror(errno));
+  // the file is mapped read-only, so an item's data is copied to be decoded -- copying it is
+  // cheaper than the page faults there'd be if it were decoded in a private mapping
+  size_t buf_size;
+  char *buf = buffer_pool_acquire(DUMP_FILE_ITEM_BUFFER_SIZE, &buf_size);
+  MetadataItem item;
+  MetadataParserStatus status;
+  while ((status = metadata_parser_next(&parser, &item)) != METADATA_PARSER_EOF) {
+    if (item.data) {
+      if (item.data_length + 1 > buf_size) {
+        buffer_pool_release(buf, buf_size);
+        buf = buffer_pool_acquire(item.data_length + 1, &buf_size);
+      }
+      memcpy(buf, item.data, item.data_length);
+      item.data = buf;
+    }
+    df->format(chunk->out, status, &item);
+  }
+  buffer_pool_release(buf, buf_size);
+  fclose(chunk->out); // which sets text and text_length
+  metadata_parser_free(&parser);
+  // the pages of the chunk won't be needed again
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t first = (chunk->start + page - 1) & ~(page - 1), last = chunk->end & ~(page - 1);
+  if (last > first)
+    madvise(df->data + first, last - first, MADV_DONTNEED);
+}
+
+static void *worker_thread(void *arg) {
+  DumpFile *df = arg;
+  pthread_mutex_lock(&df->lock);
+  while (df->next < df->count) {
+    if (df->next >= df->written + df->window) {
+      pthread_cond_wait(&df->changed, &df->lock); // the output is too far behind
+      continue;
+    }
+    Chunk *chunk = &df->chunks[df->next++];
+    pthread_mutex_unlock(&df->lock);
+    process_chunk(df, chunk);
+    pthread_mutex_lock(&df->lock);
+    chunk->done = 1;
+    if (df->unordered) {
+      write_chunk(chunk);
+      df->written++;
+    } else {
+      // if it's next, write it out, and any chunks after it that are waiting
+      while ((df->written < df->count) && df->chunks[df->written].done)
+        write_chunk(&df->chunks[df->written++]);
+    }
+    pthread_cond_broadcast(&df->changed);
+  }
+  pthread_mutex_unlock(&df->lock);
+  return NULL;
+}
+
+void dump_file_run(const char *path, int threads, ItemFormatFunction format, int flags) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if ((fd < 0) || (fstat(fd, &st) != 0))
+    die("could not open \"%s\": %s", path, strerror(errno));
+  size_t length = st.st_size;
+  if (length == 0) {
+    close(fd);
+    return;
+  }
+  char *data = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    die("could not map \"%s\": %s", path, strerror(errno));
+
+  if (threads <= 0)
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1)
+    threads = 1;
+  if (threads > DUMP_FILE_MAX_THREADS)
+    threads = DUMP_FILE_MAX_THREADS;
+  size_t count = (size_t)threads * DUMP_FILE_CHUNKS_PER_THREAD;
+  if (length / count < DUMP_FILE_MIN_CHUNK_SIZE)
+    count = (length + DUMP_FILE_MIN_CHUNK_SIZE - 1) / DUMP_FILE_MIN_CHUNK_SIZE;
+
+  DumpFile df = {.data = data,
+                 .format = format,
+                 .unordered = flags & DUMP_FILE_UNORDERED,
+                 .window = threads * DUMP_FILE_CHUNKS_AHEAD,
+                 .lock = PTHREAD_MUTEX_INITIALIZER,
+                 .changed = PTHREAD_COND_INITIALIZER};
+  df.chunks = calloc(count, sizeof(Chunk));
+  if (df.chunks == NULL)
+    die("could not allocate the chunks");
+  // the first chunk starts at the beginning, whatever is there; the rest at item boundaries
+  // found near to where they'd start if the chunks were all the same size
+  size_t start = 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t end = length;
+    if (i + 1 < count) {
+      size_t even = length / count * (i + 1);
+      // if an item is bigger than a chunk, the chunks it covers are left empty
+      end = find_chunk_start(data, length, even > start ? even : start);
+    }
+    df.chunks[df.count].start = start;
+    df.chunks[df.count].end = end;
+    df.count++;
+    start = end;
+  }
+
+  pthread_t workers[DUMP_FILE_MAX_THREADS];
+  for (int i = 0; i < threads; i++)
+    if (pthread_create(&workers[i], NULL, worker_thread, &df) != 0)
+      die("could not create a thread to process \"%s\"", path);
+  for (int i = 0; i < threads; i++)
+    pthread_join(workers[i], NULL);
+  output_flush();
+  free(df.chunks);
+  munmap(data, length);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "metadata-parser.h"
+
+// Process a saved dump of the metadata pipe, which can be gigabytes, on all the cores. The file
+// is mapped into memory and split into chunks, each starting at the beginning of an item -- a
+// line starting "<item><type>" right after the end of the item before it. The chunks are parsed
+// in place, and their items decoded and formatted, by a pool of threads, each chunk's output
+// going into a memory stream. The output of the chunks is written out in their original order
+// or, if DUMP_FILE_UNORDERED is set, in whatever order they're finished.
+//
+// To keep the memory used bounded, no more than DUMP_FILE_CHUNKS_AHEAD chunks per thread are
+// in progress, or waiting to be written out, at a time.
+
+#define DUMP_FILE_UNORDERED 1
+#define DUMP_FILE_MIN_CHUNK_SIZE (1024 * 1024)
+#define DUMP_FILE_CHUNKS_PER_THREAD 8 // if the file is big enough, for an even spread of work
+#define DUMP_FILE_CHUNKS_AHEAD 2
+#define DUMP_FILE_MAX_THREADS 64
+#define DUMP_FILE_ITEM_BUFFER_SIZE 4096 // for a copy of an item's data, to be decoded
+
+// Process the file at path with the given number of threads -- or as many as there are CPUs,
+// if it's 0 -- writing the output to stdout. The format function is called from several
+// threads at once, so it must be thread-safe. Dies if the file can't be read.
+void dump_file_run(const char *path, int threads, ItemFormatFunction format, int flags);
@@ -0,0 +1,88 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "item-filter.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint32_t type;
+  uint32_t code;
+  int any_code; // matches every code of the type
+  int only;
+} FilterEntry;
+
+// there are only ever a few entries, so they're just searched in turn
+static FilterEntry *entries;
+static int entry_count;
+static int only_count;
+
+static uint32_t fourcc(const char *s) {
+  return ((uint32_t)(unsigned char)s[0] << 24) | ((uint32_t)(unsigned char)s[1] << 16) |
+         ((uint32_t)(unsigned char)s[2] << 8) | (uint32_t)(unsigned char)s[3];
+}
+
+void item_filter_add(const char *spec, int only) {
+  const char *p = spec;
+  while (1) {
+    size_t length = strcspn(p, ",");
+    FilterEntry e = {.only = only};
+    if (length == 4) {
+      e.type = fourcc(p);
+      e.any_code = 1;
+    } else if ((length == 9) && (p[4] == '/')) {
+      e.type = fourcc(p);
+      e.code = fourcc(p + 5);
+    } else {
+      die("invalid item filter \"%s\" -- expecting TYPE or TYPE/CODE entries, separated by "
+          "commas, e.g. \"core,ssnc/pvol\"",
+          spec);
+    }
+    FilterEntry *grown = realloc(entries, (entry_count + 1) * sizeof(FilterEntry));
+    if (grown == NULL)
+      die("could not allocate an item filter");
+    entries = grown;
+    entries[entry_count++] = e;
+    if (only)
+      only_count++;
+    if (p[length] == '\0')
+      break;
+    p += length + 1;
+  }
+}
+
+int item_filter_active(void) { return entry_count != 0; }
+
+int item_filter_accepts(uint32_t type, uint32_t code) {
+  int wanted = only_count == 0;
+  for (int i = 0; i < entry_count; i++) {
+    const FilterEntry *e = &entries[i];
+    if ((e->type == type) && (e->any_code || (e->code == code))) {
+      if (!e->only)
+        return 0;
+      wanted = 1;
+    }
+  }
+  return wanted;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// Filters to pick which metadata items are wanted, by type, or by type and code. They're
+// applied as soon as an item's header has been read, so that the data of an unwanted item,
+// e.g. a picture, is skipped over without being buffered or decoded.
+//
+// A filter specification is a comma-separated list of TYPE or TYPE/CODE entries, each a
+// four-character code, e.g. "core,ssnc/pvol". If any "only" filters have been added, an item has
+// to match one of them; and it mustn't match any "skip" filter. Junk lines aren't filtered.
+
+// Add the entries in spec to the "only" filters if only is non-zero, otherwise to the "skip"
+// filters. Dies if the specification isn't valid. Add filters before reading any items.
+void item_filter_add(const char *spec, int only);
+
+// Returns 1 if there are any filters.
+int item_filter_active(void);
+
+// Returns 1 if an item of this type and code is wanted.
+int item_filter_accepts(uint32_t type, uint32_t code);
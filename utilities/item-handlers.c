@@ -0,0 +1,246 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "item-handlers.h"
+#include "bplist-print.h"
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The built-in handlers.
+// This has more information about the core tags, which might be relevant:
+// https://code.google.com/p/ytrack/wiki/DMAP
+static const ItemHandler builtin_handlers[] = {
+    {'core', 'mper', ITEM_DECODE_U64, "Persistent ID: 0x", ".\n", 0, NULL},
+    {'core', 'astm', ITEM_DECODE_U32, "Track length: ", " milliseconds.\n", 0, NULL},
+    {'core', 'asul', ITEM_DECODE_STRING, "URL: \"", "\".\n", 0, NULL},
+    {'core', 'asal', ITEM_DECODE_STRING, "Album Name: \"", "\".\n", 0, NULL},
+    {'core', 'asar', ITEM_DECODE_STRING, "Artist: \"", "\".\n", 0, NULL},
+    {'core', 'ascm', ITEM_DECODE_STRING, "Comment: \"", "\".\n", 0, NULL},
+    {'core', 'asgn', ITEM_DECODE_STRING, "Genre: \"", "\".\n", 0, NULL},
+    {'core', 'minm', ITEM_DECODE_STRING, "Title: \"", "\".\n", 0, NULL},
+    {'core', 'ascp', ITEM_DECODE_STRING, "Composer: \"", "\".\n", 0, NULL},
+    {'core', 'asdt', ITEM_DECODE_STRING, "File kind: \"", "\".\n", 0, NULL},
+    {'core', 'asdk', ITEM_DECODE_U8,
+     "Song Data Kind (\"asdk\"): (possibly 0 == timed track, 1 == untimed stream): \"", "\".\n",
+     0, NULL},
+    {'core', 'assn', ITEM_DECODE_STRING, "Sort as: \"", "\".\n", 0, NULL},
+    {'ssnc', 'PICT', ITEM_DECODE_LENGTH, "Picture received, length ", " bytes.\n", 0, NULL},
+    {'ssnc', 'clip', ITEM_DECODE_STRING, "The AirPlay client at \"",
+     "\" has connected to this player.\n", 0, NULL},
+    {'ssnc', 'pvol', ITEM_DECODE_STRING, "Volume: \"", "\".\n", 0, NULL},
+    {'ssnc', 'pcst', ITEM_DECODE_STRING, "Picture \"", "\" start.\n", 0, NULL},
+    {'ssnc', 'pcen', ITEM_DECODE_STRING, "Picture \"", "\" end.\n", 0, NULL},
+    {'ssnc', 'mdst', ITEM_DECODE_STRING, "Metadata bundle \"", "\" start.\n", 0, NULL},
+    {'ssnc', 'mden', ITEM_DECODE_STRING, "Metadata bundle \"", "\" end.\n",
+     ITEM_HANDLER_BOUNDARY, NULL},
+    {'ssnc', 'snam', ITEM_DECODE_STRING, "The name of the AirPlay client is \"", "\".\n", 0,
+     NULL},
+    {'ssnc', 'cmod', ITEM_DECODE_STRING, "The model of the AirPlay client is \"", "\".\n", 0,
+     NULL},
+    {'ssnc', 'svip', ITEM_DECODE_STRING,
+     "The address used by this player for this play session is: \"", "\".\n", 0, NULL},
+    {'ssnc', 'svna', ITEM_DECODE_STRING, "The service name of this player is: \"", "\".\n", 0,
+     NULL},
+    {'ssnc', 'conn', ITEM_DECODE_STRING, "The AirPlay client at \"",
+     "\" is about to connect to this player. (AirPlay 2 only.)\n", 0, NULL},
+    {'ssnc', 'disc', ITEM_DECODE_STRING, "The AirPlay client at \"",
+     "\" has disconnected from this player. (AirPlay 2 only.)\n", 0, NULL},
+    {'ssnc', 'cdid', ITEM_DECODE_STRING, "The AirPlay client's Device ID is \"",
+     "\". (AirPlay 2 only.)\n", 0, NULL},
+    {'ssnc', 'cmac', ITEM_DECODE_STRING, "The AirPlay client's MAC address is \"",
+     "\". (AirPlay 2 only.)\n", 0, NULL},
+    {'ssnc', 'daid', ITEM_DECODE_STRING, "The AirPlay client's DACP ID is \"", "\".\n", 0,
+     NULL},
+    {'ssnc', 'acre', ITEM_DECODE_STRING, "The AirPlay client's Active-Remote token is \"",
+     "\".\n", 0, NULL},
+    {'ssnc', 'dapo', ITEM_DECODE_STRING, "The AirPlay client's DACP port is \"", "\".\n", 0,
+     NULL},
+    {'ssnc', 'prgr', ITEM_DECODE_STRING, "Progress String \"", "\".\n", 0, NULL},
+    {'ssnc', 'sdsc', ITEM_DECODE_STRING, "Source Format \"", "\".\n", 0, NULL},
+    {'ssnc', 'odsc', ITEM_DECODE_STRING, "Output Format \"", "\".\n", 0, NULL},
+    {'ssnc', 'phb0', ITEM_DECODE_STRING, "First frame/time: \"", "\".\n", 0, NULL},
+    {'ssnc', 'phbt', ITEM_DECODE_STRING, "Playing frame/time: \"", "\".\n", 0, NULL},
+    {'ssnc', 'styp', ITEM_DECODE_STRING, "Stream type: \"", "\".\n", 0, NULL},
+    {'ssnc', 'pffr', ITEM_DECODE_STRING, "Play -- first frame received/time in ns: \"", "\".\n",
+     0, NULL},
+    {'ssnc', 'paus', ITEM_DECODE_NONE, "Pause. (AirPlay 2 only.)\n", NULL, 0, NULL},
+    {'ssnc', 'pres', ITEM_DECODE_NONE, "Resume. (AirPlay 2 only.)\n", NULL, 0, NULL},
+    {'ssnc', 'prsm', ITEM_DECODE_NONE, "Resume.\n", NULL, 0, NULL},
+    {'ssnc', 'pend', ITEM_DECODE_NONE, "Play Session End.\n", NULL, ITEM_HANDLER_BOUNDARY, NULL},
+    {'ssnc', 'pbeg', ITEM_DECODE_NONE, "Play Session Begin.\n", NULL, 0, NULL},
+    {'ssnc', 'aend', ITEM_DECODE_NONE, "Exit Active State.\n", NULL, 0, NULL},
+    {'ssnc', 'abeg', ITEM_DECODE_NONE, "Enter Active State.\n", NULL, 0, NULL},
+    {'ssnc', 'copl', ITEM_DECODE_BPLIST, "COMMAND Message Plist.\n", NULL, 0, NULL},
+};
+
+// The registry is an open-addressed hash table of pointers to handlers, at most half full,
+// so a lookup is a hash and, nearly always, a single probe.
+
+#define ITEM_HANDLERS_INITIAL_SLOTS 128
+
+static const ItemHandler **slots = NULL;
+static size_t slot_count = 0; // a power of two
+static size_t handler_count = 0;
+
+static size_t slot_for(uint32_t type, uint32_t code) {
+  uint64_t key = ((uint64_t)type << 32) | code;
+  return (size_t)((key * 0x9e3779b97f4a7c15) >> 32) & (slot_count - 1);
+}
+
+static void insert(const ItemHandler *handler) {
+  size_t i = slot_for(handler->type, handler->code);
+  while ((slots[i] != NULL) &&
+         ((slots[i]->type != handler->type) || (slots[i]->code != handler->code)))
+    i = (i + 1) & (slot_count - 1);
+  if (slots[i] == NULL)
+    handler_count++;
+  slots[i] = handler;
+}
+
+static void resize(size_t new_slot_count) {
+  const ItemHandler **old_slots = slots;
+  size_t old_slot_count = slot_count;
+  slots = calloc(new_slot_count, sizeof(ItemHandler *));
+  if (slots == NULL)
+    die("could not allocate the item handler registry");
+  slot_count = new_slot_count;
+  handler_count = 0;
+  for (size_t i = 0; i < old_slot_count; i++)
+    if (old_slots[i])
+      insert(old_slots[i]);
+  free(old_slots);
+}
+
+void item_handlers_init(void) {
+  if (slots)
+    return;
+  resize(ITEM_HANDLERS_INITIAL_SLOTS);
+  for (size_t i = 0; i < sizeof(builtin_handlers) / sizeof(ItemHandler); i++)
+    item_handler_register(&builtin_handlers[i]);
+}
+
+void item_handler_register(const ItemHandler *handler) {
+  if ((handler_count + 1) * 2 > slot_count)
+    resize(slot_count * 2);
+  insert(handler);
+}
+
+const ItemHandler *item_handler_lookup(uint32_t type, uint32_t code) {
+  size_t i = slot_for(type, code);
+  while (slots[i] != NULL) {
+    if ((slots[i]->type == type) && (slots[i]->code == code))
+      return slots[i];
+    i = (i + 1) & (slot_count - 1);
+  }
+  return NULL;
+}
+
+// the payload is decoded in place, so it may not be aligned
+static uint32_t payload_uint32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(uint32_t));
+  return ntohl(v);
+}
+
+void item_handler_print(FILE *out, const ItemHandler *handler, const ItemPayload *payload) {
+  if (handler->format) {
+    handler->format(out, handler, payload);
+    return;
+  }
+  if (handler->before)
+    fputs(handler->before, out);
+  switch (handler->decoder) {
+  case ITEM_DECODE_NONE:
+    break;
+  case ITEM_DECODE_STRING:
+    fputs(payload->data, out);
+    break;
+  case ITEM_DECODE_U8:
+    fprintf(out, "%u", payload->data_length >= 1 ? (unsigned char)payload->data[0] : 0);
+    break;
+  case ITEM_DECODE_U32:
+    fprintf(out, "%" PRIu32,
+            payload->data_length >= sizeof(uint32_t) ? payload_uint32(payload->data) : 0);
+    break;
+  case ITEM_DECODE_U64: {
+    uint64_t v = 0;
+    if (payload->data_length >= sizeof(uint64_t)) {
+      // get the 64-bit number by reading two uint32_t s and combining them
+      v = payload_uint32(payload->data);
+      v = (v << 32) + payload_uint32(payload->data + sizeof(uint32_t));
+    }
+    fprintf(out, "%" PRIx64, v);
+  } break;
+  case ITEM_DECODE_BPLIST:
+    fpretty_print_binary_plist(out, payload->data, payload->data_length, 1);
+    break;
+  case ITEM_DECODE_RAW:
+    default_print_payload(out, handler->type, handler->code, payload->data, payload->data_length,
+                          1);
+    break;
+  case ITEM_DECODE_LENGTH:
+    fprintf(out, "%zu", payload->length);
+    break;
+  }
+  if (handler->after)
+    fputs(handler->after, out);
+}
+
+void default_print_payload(FILE *out, uint32_t type, uint32_t code, const char *payload,
+                           size_t length, int interpret_plists) {
+  char typestring[5];
+  *(uint32_t *)typestring = htonl(type);
+  typestring[4] = 0;
+  char codestring[5];
+  *(uint32_t *)codestring = htonl(code);
+  codestring[4] = 0;
+  if (length > 0) {
+
+    // try to interpret plists in the feed if we have pretty printing and we're not asking for raw
+    if ((interpret_plists != 0) && (length > strlen("bplist00")) &&
+        (strncmp(payload, "bplist00", strlen("bplist00")) == 0)) {
+      fprintf(out, "\"%s\" \"%s\":\n", typestring, codestring);
+      fpretty_print_binary_plist(out, payload, length, 1);
+    } else {
+      size_t buffer_length = 128; // item size is two bytes
+      char obf[buffer_length * 2 + 1];
+      char *obfp = obf;
+      size_t obfc;
+      for (obfc = 0; ((obfc < length) && (obfc < buffer_length)); obfc++) {
+        snprintf(obfp, 3, "%02X", (unsigned char)payload[obfc]);
+        obfp += 2;
+      };
+      *obfp = 0;
+      if (length > buffer_length)
+        fprintf(out, "\"%s\" \"%s\": 0x%s... (%zu bytes in payload)\n", typestring, codestring,
+                obf, length);
+      else
+        fprintf(out, "\"%s\" \"%s\": 0x%s\n", typestring, codestring, obf);
+    }
+  } else {
+    fprintf(out, "\"%s\" \"%s\"\n", typestring, codestring);
+  }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// What to print for each kind of metadata item is held in a registry of handlers, keyed by
+// the item's (type, code) pair. A handler says how to decode the payload and how to format it.
+// The built-in handlers are in a table in item-handlers.c -- to support a new item, add an
+// entry there or register a handler at runtime with item_handler_register().
+
+typedef enum {
+  ITEM_DECODE_NONE = 0, // the payload isn't shown, just the text before it
+  ITEM_DECODE_STRING,   // a NUL-terminated string
+  ITEM_DECODE_U8,       // the first byte, as a decimal number
+  ITEM_DECODE_U32,      // a 32-bit big-endian number, in decimal
+  ITEM_DECODE_U64,      // a 64-bit big-endian number, in hexadecimal
+  ITEM_DECODE_BPLIST,   // a binary plist, pretty-printed on the lines after the text
+  ITEM_DECODE_RAW,      // as default_print_payload() does it
+  ITEM_DECODE_LENGTH    // the length given in the item, in decimal
+} ItemDecoder;
+
+#define ITEM_HANDLER_BOUNDARY 1 // the item ends a metadata bundle or a play session
+
+typedef struct {
+  uint32_t type;
+  uint32_t code;
+  const char *data;   // the decoded payload, with a NUL after it
+  size_t data_length; // the length of the decoded payload
+  size_t length;      // the length given in the item
+} ItemPayload;
+
+typedef struct ItemHandler ItemHandler;
+
+// A formatter prints an item's payload. If a handler has none, the payload is printed according
+// to its decoder, between its before and after strings.
+typedef void (*ItemFormatter)(FILE *out, const ItemHandler *handler, const ItemPayload *payload);
+
+struct ItemHandler {
+  uint32_t type;
+  uint32_t code;
+  ItemDecoder decoder;
+  const char *before; // printed before the decoded value
+  const char *after;  // and after it
+  int flags;
+  ItemFormatter format; // optional
+};
+
+// Call once, before any other item_handler function. The registry isn't thread-safe --
+// register handlers before items are dispatched from more than one thread.
+void item_handlers_init(void);
+
+// Add a handler, replacing any for the same (type, code). The handler isn't copied, so it must
+// remain valid for as long as it's registered.
+void item_handler_register(const ItemHandler *handler);
+
+// Returns the handler for (type, code), or NULL if there isn't one.
+const ItemHandler *item_handler_lookup(uint32_t type, uint32_t code);
+
+// Print the item's payload using the handler.
+void item_handler_print(FILE *out, const ItemHandler *handler, const ItemPayload *payload);
+
+// Print an item as "type" "code": and its payload in hex -- or pretty-printed, if it's a binary
+// plist and interpret_plists is set.
+void default_print_payload(FILE *out, uint32_t type, uint32_t code, const char *payload,
+                           size_t length, int interpret_plists);
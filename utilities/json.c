@@ -0,0 +1,160 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "json.h"
+#include <string.h>
+
+// What to do with each byte of a string: copy it, escape it, check that it starts a UTF-8
+// sequence of 2, 3 or 4 bytes, or replace it, e.g. a stray continuation byte.
+enum { JSON_COPY = 0, JSON_ESCAPE, JSON_UTF8_2, JSON_UTF8_3, JSON_UTF8_4, JSON_INVALID };
+
+static const unsigned char byte_class[256] = {
+    [0x00 ... 0x1f] = JSON_ESCAPE,  ['"'] = JSON_ESCAPE,           ['\\'] = JSON_ESCAPE,
+    [0x80 ... 0xc1] = JSON_INVALID, [0xc2 ... 0xdf] = JSON_UTF8_2, [0xe0 ... 0xef] = JSON_UTF8_3,
+    [0xf0 ... 0xf4] = JSON_UTF8_4,  [0xf5 ... 0xff] = JSON_INVALID};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// SWAR tests on 8 bytes at a time -- see "Bit Twiddling Hacks" by Sean Eron Anderson
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+#define HAS_ZERO_BYTE(w) (((w) - ONES) & ~(w) & HIGHS)
+#define HAS_BYTE_BELOW(w, n) (((w) - ONES * (n)) & ~(w) & HIGHS)
+
+// Returns the number of bytes from the start of s, up to length, that can be copied as they are.
+// Most strings are plain ASCII, so they're checked 8 bytes at a time before going byte by byte.
+static size_t plain_run(const unsigned char *s, size_t length) {
+  size_t i = 0;
+  while (i + 8 <= length) {
+    uint64_t w;
+    memcpy(&w, s + i, sizeof(uint64_t));
+    if ((w & HIGHS) || HAS_BYTE_BELOW(w, 0x20) || HAS_ZERO_BYTE(w ^ (ONES * '"')) ||
+        HAS_ZERO_BYTE(w ^ (ONES * '\\')))
+      break;
+    i += 8;
+  }
+  while ((i < length) && (byte_class[s[i]] == JSON_COPY))
+    i++;
+  return i;
+}
+
+// Returns the length of the valid UTF-8 sequence at s, or 0 if there isn't one. Overlong
+// encodings, surrogates and code points beyond U+10FFFF are invalid.
+static size_t utf8_sequence(const unsigned char *s, size_t length) {
+  size_t n = byte_class[s[0]] - JSON_UTF8_2 + 2;
+  if (n > length)
+    return 0;
+  unsigned char low = 0x80, high = 0xbf; // the range of the second byte
+  if (s[0] == 0xe0)
+    low = 0xa0;
+  else if (s[0] == 0xed)
+    high = 0x9f;
+  else if (s[0] == 0xf0)
+    low = 0x90;
+  else if (s[0] == 0xf4)
+    high = 0x8f;
+  if ((s[1] < low) || (s[1] > high))
+    return 0;
+  for (size_t i = 2; i < n; i++)
+    if ((s[i] & 0xc0) != 0x80)
+      return 0;
+  return n;
+}
+
+void json_print_string(FILE *out, const char *s, size_t length) {
+  const unsigned char *p = (const unsigned char *)s;
+  const unsigned char *end = p + length;
+  fputc('"', out);
+  while (p < end) {
+    size_t run = plain_run(p, end - p);
+    if (run) {
+      fwrite(p, 1, run, out);
+      p += run;
+      continue;
+    }
+    switch (byte_class[*p]) {
+    case JSON_ESCAPE:
+      fputc('\\', out);
+      switch (*p) {
+      case '"':
+      case '\\':
+        fputc(*p, out);
+        break;
+      case '\n':
+        fputc('n', out);
+        break;
+      case '\r':
+        fputc('r', out);
+        break;
+      case '\t':
+        fputc('t', out);
+        break;
+      default:
+        fprintf(out, "u00%c%c", hex_digits[*p >> 4], hex_digits[*p & 0xf]);
+      }
+      p++;
+      break;
+    case JSON_UTF8_2:
+    case JSON_UTF8_3:
+    case JSON_UTF8_4: {
+      size_t n = utf8_sequence(p, end - p);
+      if (n) {
+        fwrite(p, 1, n, out);
+        p += n;
+        break;
+      }
+    } // fall through -- it's not valid
+    default:
+      fputs("\\ufffd", out);
+      p++;
+    }
+  }
+  fputc('"', out);
+}
+
+void json_print_fourcc(FILE *out, uint32_t code) {
+  char s[4] = {(char)(code >> 24), (char)(code >> 16), (char)(code >> 8), (char)code};
+  json_print_string(out, s, sizeof(s));
+}
+
+void json_print_base64(FILE *out, const void *data, size_t length) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const unsigned char *p = data;
+  char quad[4];
+  fputc('"', out);
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t v = (uint32_t)p[i] << 16;
+    if (i + 1 < length)
+      v |= (uint32_t)p[i + 1] << 8;
+    if (i + 2 < length)
+      v |= p[i + 2];
+    quad[0] = alphabet[v >> 18];
+    quad[1] = alphabet[(v >> 12) & 0x3f];
+    quad[2] = i + 1 < length ? alphabet[(v >> 6) & 0x3f] : '=';
+    quad[3] = i + 2 < length ? alphabet[v & 0x3f] : '=';
+    fwrite(quad, 1, sizeof(quad), out);
+  }
+  fputc('"', out);
+}
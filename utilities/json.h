@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Helpers for writing JSON.
+
+// Print length bytes of s as a quoted JSON string. Quotes, backslashes and control characters
+// are escaped and anything that isn't valid UTF-8 is replaced by U+FFFD, so the output is valid
+// JSON whatever is in s.
+void json_print_string(FILE *out, const char *s, size_t length);
+
+// Print a four-character code, like an item's type, as a JSON string.
+void json_print_fourcc(FILE *out, uint32_t code);
+
+// Print length bytes of data as a quoted base64 string.
+void json_print_base64(FILE *out, const void *data, size_t length);
@@ -0,0 +1,320 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "metadata-parser.h"
+#include "buffer-pool.h"
+#include "clock.h"
+#include "item-filter.h"
+#include <string.h>
+#include <unistd.h>
+
+#define METADATA_PARSER_INITIAL_SIZE (64 * 1024)
+
+// the parser's states -- where it is in an item
+enum { PARSE_HEADER = 0, PARSE_DATA_OPEN, PARSE_DATA, PARSE_DATA_CLOSE };
+
+static const char item_open[] = "<item><type>";
+static const char data_open[] = "<data encoding=\"base64\">";
+static const char data_close[] = "</data></item>";
+
+#define STRLEN(s) (sizeof(s) - 1)
+
+// the most base64 text an item's data section can hold
+#define METADATA_PARSER_MAX_DATA (4 * ((METADATA_PARSER_MAX_ITEM + 2) / 3))
+
+void metadata_parser_init(MetadataParser *parser, int fd) {
+  memset(parser, 0, sizeof(MetadataParser));
+  parser->fd = fd;
+  parser->buf = buffer_pool_acquire(METADATA_PARSER_INITIAL_SIZE, &parser->size);
+}
+
+void metadata_parser_init_buffer(MetadataParser *parser, char *data, size_t length) {
+  memset(parser, 0, sizeof(MetadataParser));
+  parser->fd = -1;
+  parser->buf = data;
+  parser->size = parser->end = length;
+  parser->borrowed = 1;
+  parser->read_ns = monotonic_ns();
+}
+
+void metadata_parser_free(MetadataParser *parser) {
+  if (!parser->borrowed)
+    buffer_pool_release(parser->buf, parser->size);
+  parser->buf = NULL;
+}
+
+void metadata_parser_reset(MetadataParser *parser) {
+  parser->state = PARSE_HEADER;
+  parser->start = parser->end = parser->scan = parser->data_start = parser->want = 0;
+  metadata_parser_idle(parser);
+}
+
+void metadata_parser_idle(MetadataParser *parser) {
+  if ((parser->state == PARSE_HEADER) && (parser->start == parser->end) && parser->buf &&
+      !parser->borrowed) {
+    buffer_pool_release(parser->buf, parser->size);
+    parser->buf = NULL;
+    parser->size = parser->start = parser->end = parser->scan = 0;
+  }
+}
+
+// Move the unconsumed bytes into a buffer of at least new_size bytes from the pool.
+static void rebuffer(MetadataParser *parser, size_t new_size) {
+  size_t size;
+  char *buf = buffer_pool_acquire(new_size, &size);
+  memcpy(buf, parser->buf, parser->end);
+  buffer_pool_release(parser->buf, parser->size);
+  parser->buf = buf;
+  parser->size = size;
+}
+
+// Read more input into the buffer, first moving any unconsumed bytes down to the start of it
+// or, if they already fill it, growing it. Once a big item has been dealt with, the buffer
+// goes back to its initial size. Returns the number of bytes read, 0 at EOF or -1 on error.
+static ssize_t fill(MetadataParser *parser) {
+  if (parser->borrowed)
+    return 0; // all the input is in the buffer already
+  if (parser->buf == NULL)
+    parser->buf = buffer_pool_acquire(METADATA_PARSER_INITIAL_SIZE, &parser->size);
+  if (parser->start != 0) {
+    size_t shift = parser->start;
+    memmove(parser->buf, parser->buf + shift, parser->end - shift);
+    parser->end -= shift;
+    parser->scan -= shift;
+    parser->data_start -= shift;
+    parser->start = 0;
+  }
+  if ((parser->end == parser->size) || (parser->want > parser->size))
+    rebuffer(parser, parser->want > parser->size * 2 ? parser->want : parser->size * 2);
+  else if ((parser->size > METADATA_PARSER_INITIAL_SIZE) && (parser->state == PARSE_HEADER) &&
+           (parser->end < METADATA_PARSER_INITIAL_SIZE / 2))
+    rebuffer(parser, METADATA_PARSER_INITIAL_SIZE);
+  if (parser->before_read)
+    parser->before_read(parser->fd);
+  ssize_t nread = read(parser->fd, parser->buf + parser->end, parser->size - parser->end);
+  if (nread > 0) {
+    parser->read_ns = monotonic_ns();
+    parser->end += nread;
+  }
+  return nread;
+}
+
+// Look for c from the resume point onwards. If it's not there, the resume point is
+// moved to the end of the buffered input, so nothing is scanned twice.
+static char *find(MetadataParser *parser, char c) {
+  if (parser->scan == parser->end)
+    return NULL;
+  char *p = memchr(parser->buf + parser->scan, c, parser->end - parser->scan);
+  if (p == NULL)
+    parser->scan = parser->end;
+  return p;
+}
+
+static int match(const char **p, const char *limit, const char *s, size_t len) {
+  if (((size_t)(limit - *p) < len) || (memcmp(*p, s, len) != 0))
+    return 0;
+  *p += len;
+  return 1;
+}
+
+static int parse_hex32(const char **p, const char *limit, uint32_t *value) {
+  uint32_t v = 0;
+  int digits = 0;
+  const char *q = *p;
+  while ((q < limit) && (digits < 8)) {
+    unsigned int c = (unsigned char)*q;
+    if ((c >= '0') && (c <= '9'))
+      c = c - '0';
+    else if ((c >= 'a') && (c <= 'f'))
+      c = c - 'a' + 10;
+    else if ((c >= 'A') && (c <= 'F'))
+      c = c - 'A' + 10;
+    else
+      break;
+    v = (v << 4) | c;
+    digits++;
+    q++;
+  }
+  if (digits == 0)
+    return 0;
+  *value = v;
+  *p = q;
+  return 1;
+}
+
+static int parse_size(const char **p, const char *limit, size_t *value) {
+  size_t v = 0;
+  const char *q = *p;
+  while ((q < limit) && (*q >= '0') && (*q <= '9')) {
+    size_t nv = v * 10 + (size_t)(*q - '0');
+    if (nv < v)
+      return 0; // overflow
+    v = nv;
+    q++;
+  }
+  if (q == *p)
+    return 0;
+  *value = v;
+  *p = q;
+  return 1;
+}
+
+// Parse "<item><type>%x</type><code>%x</code><length>%zu</length>" at the start of a line.
+// Returns a pointer to what follows, or NULL if the line isn't an item header.
+static const char *parse_header(const char *p, const char *limit, MetadataItem *item) {
+  if (match(&p, limit, item_open, STRLEN(item_open)) && parse_hex32(&p, limit, &item->type) &&
+      match(&p, limit, "</type><code>", STRLEN("</type><code>")) &&
+      parse_hex32(&p, limit, &item->code) &&
+      match(&p, limit, "</code><length>", STRLEN("</code><length>")) &&
+      parse_size(&p, limit, &item->length) &&
+      match(&p, limit, "</length>", STRLEN("</length>")))
+    return p;
+  return NULL;
+}
+
+static MetadataParserStatus next_item(MetadataParser *parser, MetadataItem *item) {
+  while (1) {
+    switch (parser->state) {
+    case PARSE_HEADER: {
+      while ((parser->start < parser->end) &&
+             ((parser->buf[parser->start] == '\n') || (parser->buf[parser->start] == '\r')))
+        parser->start++;
+      if (parser->scan < parser->start)
+        parser->scan = parser->start;
+      char *nl = find(parser, '\n');
+      const char *line = parser->buf + parser->start;
+      const char *rest = NULL;
+      if (nl != NULL)
+        rest = parse_header(line, nl, &parser->item);
+      else if (parser->end - parser->start <= METADATA_PARSER_MAX_LINE)
+        break; // need more input
+      if (rest == NULL) {
+        // not a header, or too long to be one -- in which case what there is of it is returned
+        size_t length = nl != NULL ? (size_t)(nl + 1 - line) : parser->end - parser->start;
+        item->type = 0;
+        item->code = 0;
+        item->length = 0;
+        item->flags = 0;
+        item->data = parser->buf + parser->start;
+        item->data_length = length;
+        parser->start = parser->scan = parser->start + length;
+        return METADATA_PARSER_JUNK;
+      }
+      parser->item.data = NULL;
+      parser->item.data_length = 0;
+      parser->item.flags = 0;
+      parser->skip = !item_filter_accepts(parser->item.type, parser->item.code);
+      if (!parser->skip && (parser->item.length > METADATA_PARSER_MAX_ITEM)) {
+        debug(1, "an item of %zu bytes is too long, so it was dropped", parser->item.length);
+        parser->skip = 1;
+      }
+      parser->start = parser->scan = nl + 1 - parser->buf;
+      if (match(&rest, nl, "</item>", STRLEN("</item>"))) {
+        if (parser->skip)
+          continue;
+        *item = parser->item;
+        return METADATA_PARSER_ITEM;
+      }
+      parser->state = PARSE_DATA_OPEN;
+      continue;
+    }
+    case PARSE_DATA_OPEN: {
+      char *nl = find(parser, '\n');
+      const char *line = parser->buf + parser->start;
+      if (nl == NULL) {
+        if (parser->end - parser->start <= METADATA_PARSER_MAX_LINE)
+          break;
+        // too long to be the data tag -- it'll be returned as junk after the item
+      } else if (match(&line, nl, data_open, STRLEN(data_open))) {
+        parser->start = parser->scan = nl + 1 - parser->buf;
+        parser->data_start = parser->start;
+        // if the base64 text is going to need a bigger buffer, get it in one go -- unless it's
+        // to be skipped, in which case it's discarded as it's read
+        if (!parser->skip)
+          parser->want = 4 * ((parser->item.length + 2) / 3) + STRLEN(data_close) + 1;
+        parser->state = PARSE_DATA;
+        continue;
+      } else if (strncmp(line, item_open, STRLEN(item_open)) != 0) {
+        // no data section after all, and it's not the start of the next item, so discard it
+        parser->start = parser->scan = nl + 1 - parser->buf;
+      }
+      parser->state = PARSE_HEADER;
+      if (parser->skip)
+        continue;
+      *item = parser->item;
+      return METADATA_PARSER_ITEM;
+    }
+    case PARSE_DATA: {
+      // base64 has no '<' in it, so the first one is the start of the closing tag
+      char *lt = find(parser, '<');
+      if (lt != NULL)
+        parser->scan = lt - parser->buf;
+      if (!parser->skip && (parser->scan - parser->data_start > METADATA_PARSER_MAX_DATA)) {
+        debug(1, "an item's data section is too long, so it was dropped");
+        parser->skip = 1;
+        parser->want = 0;
+      }
+      if (parser->skip) // the data isn't wanted, so there's no need to keep it
+        parser->start = parser->data_start = parser->scan;
+      if (lt == NULL)
+        break;
+      // start stays at the data until the item is returned, scan is left at the closing tag
+      parser->item.data_length = lt - (parser->buf + parser->data_start);
+      parser->state = PARSE_DATA_CLOSE;
+      continue;
+    }
+    case PARSE_DATA_CLOSE: {
+      if (parser->end - parser->scan < STRLEN(data_close))
+        break;
+      const char *p = parser->buf + parser->scan;
+      if (!match(&p, parser->buf + parser->end, data_close, STRLEN(data_close)))
+        parser->item.flags |= METADATA_ITEM_NO_END_TAG;
+      parser->start = parser->scan = p - parser->buf;
+      parser->item.data = parser->buf + parser->data_start;
+      parser->want = 0;
+      parser->state = PARSE_HEADER;
+      if (parser->skip)
+        continue;
+      *item = parser->item;
+      return METADATA_PARSER_ITEM;
+    }
+    }
+    ssize_t nread = fill(parser);
+    if (nread == 0)
+      return METADATA_PARSER_EOF;
+    if (nread < 0)
+      return METADATA_PARSER_ERROR;
+  }
+}
+
+MetadataParserStatus metadata_parser_next(MetadataParser *parser, MetadataItem *item) {
+  MetadataParserStatus status = next_item(parser, item);
+  if ((status == METADATA_PARSER_ITEM) || (status == METADATA_PARSER_JUNK)) {
+    item->sequence = parser->sequence++;
+    item->received_ns = parser->read_ns;
+    if (parser->after_item)
+      parser->after_item(status, item);
+  }
+  return status;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Incremental parser for the metadata stream Shairport Sync writes to its pipe.
+// Each item looks like this (the data section is present only if length > 0):
+//
+// <item><type>636f7265</type><code>6173616c</code><length>9</length>
+// <data encoding="base64">
+// UGVyZ29sZXNp</data></item>
+//
+// The input is read in large chunks with read(2) into a buffer owned by the parser
+// and item boundaries are found in a single pass over it. Tags may be split across reads
+// and the data section may be of any length -- the buffer, which comes from the buffer pool,
+// grows to hold it. Items not wanted by the filters in item-filter.h are skipped as soon as their
+// header has been read, without their data being buffered.
+//
+// The input isn't trusted: items longer than METADATA_PARSER_MAX_ITEM, or whose data section
+// turns out to be longer than that, are skipped in the same way, and a line that runs on for
+// more than METADATA_PARSER_MAX_LINE bytes without being a header is returned as junk, in pieces.
+
+#define METADATA_PARSER_MAX_ITEM (64 * 1024 * 1024)
+#define METADATA_PARSER_MAX_LINE 1024
+
+typedef enum {
+  METADATA_PARSER_ITEM = 0, // a complete item is in the MetadataItem
+  METADATA_PARSER_JUNK,     // a line that isn't an item header is in data/data_length
+  METADATA_PARSER_EOF,      // the writer has closed its end of the pipe
+  METADATA_PARSER_ERROR     // a read error, or interrupted by a signal; errno is set
+} MetadataParserStatus;
+
+#define METADATA_ITEM_NO_END_TAG 1 // the data section wasn't followed by </data></item>
+#define METADATA_ITEM_DECODED 2    // the data is the payload itself, not base64 -- see udp-source.h
+
+typedef struct {
+  uint32_t type;
+  uint32_t code;
+  size_t length;      // the length in the <length> tag, i.e. of the decoded data
+  char *data;         // the base64 text, if any, in the parser's buffer
+  size_t data_length; // valid until the next call to metadata_parser_next()
+  int flags;
+  uint64_t sequence;    // the number of items and junk lines the parser returned before this one
+  uint64_t received_ns; // when the read that completed it returned, on the CLOCK_MONOTONIC clock
+} MetadataItem;
+
+typedef struct {
+  int fd;
+  char *buf;
+  size_t size;  // bytes allocated to buf
+  size_t start; // first unconsumed byte
+  size_t end;   // one past the last byte read in
+  size_t scan;  // where to resume looking for a delimiter
+  size_t data_start;
+  size_t want; // the buffer size the item being read needs, if known
+  int state;
+  int skip;          // the item being read isn't wanted
+  int borrowed;      // buf is the whole input, belonging to the caller, not a pool buffer
+  MetadataItem item; // the item being assembled
+  uint64_t sequence; // of the next item
+  uint64_t read_ns;  // when the last read returned
+  void (*before_read)(int fd); // if set, called before each read(2), which may block
+  // if set, called with each item or junk line before it's returned, e.g. to record it
+  void (*after_item)(MetadataParserStatus status, const MetadataItem *item);
+} MetadataParser;
+
+void metadata_parser_init(MetadataParser *parser, int fd);
+
+// Parse the input in data, e.g. a mapped file, in place -- the end of it is the end of the
+// input. Items' data point into it, so if it's read-only, copy an item's data before passing it
+// to a formatter, which may modify it.
+void metadata_parser_init_buffer(MetadataParser *parser, char *data, size_t length);
+
+void metadata_parser_free(MetadataParser *parser);
+MetadataParserStatus metadata_parser_next(MetadataParser *parser, MetadataItem *item);
+
+// Discard anything buffered, e.g. part of an item left when the writer went away, and give the
+// buffer back to the pool. The parser carries on reading from the same fd.
+void metadata_parser_reset(MetadataParser *parser);
+
+// If no part of an item is buffered, give the buffer back to the pool until more input
+// arrives. Call this when a parser may be idle for a while.
+void metadata_parser_idle(MetadataParser *parser);
+
+// Format an item or a junk line to out, returning non-zero if it ends a metadata bundle or a
+// play session. The item's data may be modified, e.g. decoded in place, and there's room for a
+// NUL after it.
+typedef int (*ItemFormatFunction)(FILE *out, MetadataParserStatus status, MetadataItem *item);
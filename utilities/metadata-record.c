@@ -0,0 +1,138 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "metadata-record.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(MetadataRecordStreamHeader) % METADATA_RECORD_ALIGNMENT == 0,
+               "records after the stream header must be aligned");
+_Static_assert(sizeof(MetadataRecordHeader) % METADATA_RECORD_ALIGNMENT == 0,
+               "payloads must be aligned");
+
+void metadata_record_write_stream_header(FILE *out) {
+  MetadataRecordStreamHeader header = {.version = htole32(METADATA_RECORD_VERSION),
+                                       .header_size = htole32(sizeof(MetadataRecordHeader))};
+  memcpy(header.magic, METADATA_RECORD_MAGIC, sizeof(header.magic));
+  fwrite(&header, sizeof(header), 1, out);
+}
+
+MetadataRecordHeader metadata_record_header_to_le(const MetadataRecordHeader *header) {
+  MetadataRecordHeader le = {.type = htole32(header->type),
+                             .code = htole32(header->code),
+                             .flags = htole32(header->flags),
+                             .payload_length = htole32(header->payload_length),
+                             .sequence = htole64(header->sequence),
+                             .received_ns = htole64(header->received_ns)};
+  return le;
+}
+
+void metadata_record_write(FILE *out, const MetadataRecordHeader *header, const void *payload) {
+  static const char padding[METADATA_RECORD_ALIGNMENT] = {0};
+  MetadataRecordHeader le = metadata_record_header_to_le(header);
+  fwrite(&le, sizeof(MetadataRecordHeader), 1, out);
+  if (header->payload_length)
+    fwrite(payload, 1, header->payload_length, out);
+  fwrite(padding, 1,
+         metadata_record_size(header->payload_length) - sizeof(MetadataRecordHeader) -
+             header->payload_length,
+         out);
+}
+
+int metadata_record_reader_init(MetadataRecordReader *reader, const void *data, size_t length) {
+  memset(reader, 0, sizeof(MetadataRecordReader));
+  const MetadataRecordStreamHeader *header = data;
+  if ((length < sizeof(MetadataRecordStreamHeader)) ||
+      (memcmp(header->magic, METADATA_RECORD_MAGIC, sizeof(header->magic)) != 0) ||
+      (le32toh(header->version) != METADATA_RECORD_VERSION) ||
+      (le32toh(header->header_size) != sizeof(MetadataRecordHeader)))
+    return -1;
+  reader->data = data;
+  reader->length = length;
+  reader->offset = sizeof(MetadataRecordStreamHeader);
+  return 0;
+}
+
+int metadata_record_reader_map(MetadataRecordReader *reader, const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  if ((size_t)st.st_size < sizeof(MetadataRecordStreamHeader)) {
+    close(fd);
+    errno = EINVAL; // too short to be a stream
+    return -1;
+  }
+  void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int mmap_errno = errno;
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    errno = mmap_errno;
+    return -1;
+  }
+  if (metadata_record_reader_init(reader, mapping, st.st_size) != 0) {
+    munmap(mapping, st.st_size);
+    errno = EINVAL;
+    return -1;
+  }
+  madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+  reader->mapping = mapping;
+  return 0;
+}
+
+void metadata_record_reader_free(MetadataRecordReader *reader) {
+  if (reader->mapping)
+    munmap(reader->mapping, reader->length);
+  reader->mapping = NULL;
+}
+
+const MetadataRecordHeader *metadata_record_next(MetadataRecordReader *reader,
+                                                 const unsigned char **payload) {
+  reader->truncated = 0;
+  if (reader->offset > reader->length) {
+    reader->truncated = 1; // it can't be in the stream
+    return NULL;
+  }
+  size_t remaining = reader->length - reader->offset;
+  if (remaining == 0)
+    return NULL;
+  const MetadataRecordHeader *header =
+      (const MetadataRecordHeader *)(reader->data + reader->offset);
+  if ((remaining < sizeof(MetadataRecordHeader)) ||
+      (remaining < metadata_record_size(metadata_record_payload_length(header)))) {
+    reader->truncated = 1;
+    return NULL;
+  }
+  *payload = reader->data + reader->offset + sizeof(MetadataRecordHeader);
+  reader->offset += metadata_record_size(metadata_record_payload_length(header));
+  return header;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <endian.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// The binary record format written by the --binary option, for programs that want the items
+// themselves rather than text about them, and a small library to read it.
+//
+// A stream of records starts with a MetadataRecordStreamHeader. Each record that follows is a
+// MetadataRecordHeader, then payload_length bytes of payload, then zero padding up to a multiple
+// of METADATA_RECORD_ALIGNMENT bytes. So a consumer can map a file of records into memory and
+// use every header where it lies, and point at every payload, without copying anything.
+// All numbers are little-endian, whatever machine wrote them -- read them with the accessors
+// below, which convert them to the machine's byte order. Type and code are four-character codes
+// as numbers, so that 'core' is 0x636f7265.
+//
+// The payload of an item is its decoded data. The payload of a junk line -- a line that isn't
+// an item -- is the line itself.
+//
+// The same format is used for the capture files written by --record, whose records hold the
+// items as they were read, flagged METADATA_RECORD_RAW, to be fed through the parser again by
+// --replay. To find a point in a long capture quickly, there's an index record after every
+// METADATA_RECORD_INDEX_INTERVAL raw records, holding the times and offsets of every
+// METADATA_RECORD_INDEX_STRIDE-th of them and the offset of the index record before it. When
+// the capture is closed, an index record for the last few raw records is written, followed by
+// an end record holding its offset -- so a reader can start at the end record and follow the
+// index records back from there.
+
+#define METADATA_RECORD_MAGIC "SSMDREC1" // the first 8 bytes of a stream, without a NUL
+#define METADATA_RECORD_VERSION 1
+#define METADATA_RECORD_ALIGNMENT 8
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size; // of each MetadataRecordHeader -- later versions may add to the end
+} MetadataRecordStreamHeader;
+
+#define METADATA_RECORD_JUNK 1        // a junk line, not an item; type and code are 0
+#define METADATA_RECORD_NOT_DECODED 2 // the data wasn't valid base64, so there's no payload
+#define METADATA_RECORD_NO_END_TAG 4  // the data wasn't followed by its closing tag
+#define METADATA_RECORD_TRUNCATED 8   // the payload was too big to write, so it's left out
+#define METADATA_RECORD_RAW 16        // the payload is the item or junk line as it was read
+#define METADATA_RECORD_INDEX 32      // an index record -- see MetadataRecordIndex
+#define METADATA_RECORD_END 64        // the last record -- its payload is the last index's offset
+
+#define METADATA_RECORD_INDEX_INTERVAL 1024
+#define METADATA_RECORD_INDEX_STRIDE 64
+
+typedef struct {
+  uint32_t type;
+  uint32_t code;
+  uint32_t flags;
+  uint32_t payload_length;
+  uint64_t sequence;    // counts the items and junk lines received, from 0
+  uint64_t received_ns; // when it was received, in ns on the receiver's CLOCK_MONOTONIC clock
+} MetadataRecordHeader;
+
+// The payload of an index record is a MetadataRecordIndex followed by count entries.
+typedef struct {
+  uint64_t previous; // the offset of the index record before this one, or 0 if there isn't one
+  uint32_t count;
+  uint32_t stride; // the entries are for every stride-th raw record
+} MetadataRecordIndex;
+
+typedef struct {
+  uint64_t received_ns;
+  uint64_t offset; // of the raw record received then
+} MetadataRecordIndexEntry;
+
+// Accessors for the fields of headers and index records where they lie in a stream.
+static inline uint32_t metadata_record_type(const MetadataRecordHeader *h) {
+  return le32toh(h->type);
+}
+static inline uint32_t metadata_record_code(const MetadataRecordHeader *h) {
+  return le32toh(h->code);
+}
+static inline uint32_t metadata_record_flags(const MetadataRecordHeader *h) {
+  return le32toh(h->flags);
+}
+static inline uint32_t metadata_record_payload_length(const MetadataRecordHeader *h) {
+  return le32toh(h->payload_length);
+}
+static inline uint64_t metadata_record_sequence(const MetadataRecordHeader *h) {
+  return le64toh(h->sequence);
+}
+static inline uint64_t metadata_record_received_ns(const MetadataRecordHeader *h) {
+  return le64toh(h->received_ns);
+}
+static inline uint64_t metadata_record_index_previous(const MetadataRecordIndex *index) {
+  return le64toh(index->previous);
+}
+static inline uint32_t metadata_record_index_count(const MetadataRecordIndex *index) {
+  return le32toh(index->count);
+}
+static inline uint64_t metadata_record_entry_received_ns(const MetadataRecordIndexEntry *e) {
+  return le64toh(e->received_ns);
+}
+static inline uint64_t metadata_record_entry_offset(const MetadataRecordIndexEntry *e) {
+  return le64toh(e->offset);
+}
+
+// Returns the space a record with a payload of payload_length bytes takes up.
+static inline size_t metadata_record_size(size_t payload_length) {
+  return (sizeof(MetadataRecordHeader) + payload_length + METADATA_RECORD_ALIGNMENT - 1) &
+         ~(size_t)(METADATA_RECORD_ALIGNMENT - 1);
+}
+
+// Writing
+
+void metadata_record_write_stream_header(FILE *out);
+
+// Returns a copy of a header, given in the machine's byte order, in the stream's byte order.
+MetadataRecordHeader metadata_record_header_to_le(const MetadataRecordHeader *header);
+
+// Write a record -- the header, payload_length bytes of payload and the padding after it. The
+// header is given in the machine's byte order.
+void metadata_record_write(FILE *out, const MetadataRecordHeader *header, const void *payload);
+
+// Reading
+
+typedef struct {
+  const unsigned char *data; // the stream, which must be 8-byte aligned, as a mapping is
+  size_t length;
+  size_t offset;  // of the next record
+  int truncated;  // set if the stream ended part of the way through a record
+  void *mapping;  // if it was mapped by metadata_record_reader_map()
+} MetadataRecordReader;
+
+// Start reading the stream of length bytes at data. Returns 0 on success or -1 if it isn't a
+// stream of records in a version this library understands.
+int metadata_record_reader_init(MetadataRecordReader *reader, const void *data, size_t length);
+
+// Map the file at path into memory and start reading it. Returns 0 on success or -1 on error,
+// with errno set -- to EINVAL if the file isn't a stream of records.
+int metadata_record_reader_map(MetadataRecordReader *reader, const char *path);
+
+// Unmap the file, if it was mapped. Headers and payloads from it are no longer valid.
+void metadata_record_reader_free(MetadataRecordReader *reader);
+
+// Returns the header of the next record, pointing *payload at its payload, or NULL at the end
+// of the stream. Both point into the stream, so the header's fields are little-endian. If the stream ends part of the way through a
+// record, the record is ignored and truncated is set -- a stream still being written can be
+// read again from offset once there's more of it.
+const MetadataRecordHeader *metadata_record_next(MetadataRecordReader *reader,
+                                                 const unsigned char **payload);
@@ -0,0 +1,251 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "now-playing.h"
+#include "item-handlers.h"
+#include "json.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint32_t type;
+  uint32_t code;
+  const char *name;
+  ItemDecoder decoder; // ITEM_DECODE_STRING, ITEM_DECODE_U32 or ITEM_DECODE_U64
+  int in_bundle;       // a track field, sent between mdst and mden
+  char *value;         // the current value, NULL if it's never been set
+  char *pending;       // a value received in the open bundle, NULL if none
+  int changed;         // the value has changed since the last record
+} StateField;
+
+static StateField fields[] = {
+    {'core', 'minm', "title", ITEM_DECODE_STRING, 1, NULL, NULL, 0},
+    {'core', 'asar', "artist", ITEM_DECODE_STRING, 1, NULL, NULL, 0},
+    {'core', 'asal', "album", ITEM_DECODE_STRING, 1, NULL, NULL, 0},
+    {'core', 'asgn', "genre", ITEM_DECODE_STRING, 1, NULL, NULL, 0},
+    {'core', 'ascp', "composer", ITEM_DECODE_STRING, 1, NULL, NULL, 0},
+    {'core', 'assn', "sort_as", ITEM_DECODE_STRING, 1, NULL, NULL, 0},
+    {'core', 'astm', "track_length", ITEM_DECODE_U32, 1, NULL, NULL, 0},
+    {'core', 'mper', "persistent_id", ITEM_DECODE_U64, 1, NULL, NULL, 0},
+    {'ssnc', 'pvol', "volume", ITEM_DECODE_STRING, 0, NULL, NULL, 0},
+    {'ssnc', 'prgr', "progress", ITEM_DECODE_STRING, 0, NULL, NULL, 0},
+    {'ssnc', 'snam', "client_name", ITEM_DECODE_STRING, 0, NULL, NULL, 0},
+    {'ssnc', 'clip', "client_ip", ITEM_DECODE_STRING, 0, NULL, NULL, 0},
+    {'ssnc', 'cmod', "client_model", ITEM_DECODE_STRING, 0, NULL, NULL, 0},
+};
+
+#define FIELD_COUNT (sizeof(fields) / sizeof(fields[0]))
+
+static int json_records = 0;
+static int in_bundle = 0;
+static char *bundle_key = NULL; // the RTP timestamp of the open bundle
+
+static StateField *field_for(uint32_t type, uint32_t code) {
+  for (size_t i = 0; i < FIELD_COUNT; i++)
+    if ((fields[i].type == type) && (fields[i].code == code))
+      return &fields[i];
+  return NULL;
+}
+
+// Returns the payload as a newly-allocated string, in the form the field is shown in.
+static char *field_value(const StateField *field, const char *payload, size_t length) {
+  char number[24];
+  char *value;
+  // the payload is decoded in place, so it may not be aligned
+  if ((field->decoder == ITEM_DECODE_U32) && (length >= 4)) {
+    uint32_t v;
+    memcpy(&v, payload, sizeof(uint32_t));
+    snprintf(number, sizeof(number), "%" PRIu32, ntohl(v));
+    value = strdup(number);
+  } else if ((field->decoder == ITEM_DECODE_U64) && (length >= 8)) {
+    uint32_t hi, lo;
+    memcpy(&hi, payload, sizeof(uint32_t));
+    memcpy(&lo, payload + 4, sizeof(uint32_t));
+    snprintf(number, sizeof(number), "0x%08" PRIx32 "%08" PRIx32, ntohl(hi), ntohl(lo));
+    value = strdup(number);
+  } else {
+    value = strndup(payload, length);
+  }
+  if (value == NULL)
+    die("could not allocate a now-playing field");
+  return value;
+}
+
+// Make value the field's value, taking ownership of it. Returns 1 if that changes it.
+static int merge(StateField *field, char *value) {
+  if ((field->value != NULL) && (strcmp(field->value, value) == 0)) {
+    free(value);
+    return 0;
+  }
+  free(field->value);
+  field->value = value;
+  field->changed = 1;
+  return 1;
+}
+
+static void print_quoted(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if ((c == '"') || (c == '\\'))
+      fprintf(out, "\\%c", c);
+    else if (c == '\n')
+      fputs("\\n", out);
+    else if (c == '\t')
+      fputs("\\t", out);
+    else if ((c < 0x20) || (c == 0x7f))
+      fprintf(out, "\\x%02x", c);
+    else
+      fputc(c, out);
+  }
+  fputc('"', out);
+}
+
+void now_playing_set_json(int json) { json_records = json; }
+
+// Print a number, given as text, as a JSON number -- or as a JSON string, if it isn't one.
+static void print_json_number(FILE *out, const char *s) {
+  char *end;
+  errno = 0;
+  unsigned long long v = strtoull(s, &end, 0);
+  if ((*s >= '0') && (*s <= '9') && (*end == '\0') && (errno == 0))
+    fprintf(out, "%llu", v);
+  else
+    json_print_string(out, s, strlen(s));
+}
+
+static void print_json_record(FILE *out, const char *key) {
+  const char *separator = "";
+  fputs("{\"now_playing\":{", out);
+  if (key) {
+    fputs("\"rtp\":", out);
+    print_json_number(out, key);
+    separator = ",";
+  }
+  for (size_t i = 0; i < FIELD_COUNT; i++) {
+    StateField *field = &fields[i];
+    if (!field->changed)
+      continue;
+    fprintf(out, "%s\"%s\":", separator, field->name);
+    if (field->decoder == ITEM_DECODE_STRING)
+      json_print_string(out, field->value, strlen(field->value));
+    else
+      print_json_number(out, field->value);
+    field->changed = 0;
+    separator = ",";
+  }
+  fputs("}}\n", out);
+}
+
+// Print the changed fields and clear their changed flags.
+static void print_record(FILE *out, const char *key) {
+  if (json_records) {
+    print_json_record(out, key);
+    return;
+  }
+  fputs("now-playing", out);
+  if (key)
+    fprintf(out, " rtp=%s", key);
+  for (size_t i = 0; i < FIELD_COUNT; i++) {
+    StateField *field = &fields[i];
+    if (!field->changed)
+      continue;
+    fprintf(out, " %s=", field->name);
+    if (field->decoder == ITEM_DECODE_STRING)
+      print_quoted(out, field->value);
+    else
+      fputs(field->value, out);
+    field->changed = 0;
+  }
+  fputc('\n', out);
+}
+
+static void discard_bundle(void) {
+  for (size_t i = 0; i < FIELD_COUNT; i++) {
+    free(fields[i].pending);
+    fields[i].pending = NULL;
+  }
+  free(bundle_key);
+  bundle_key = NULL;
+  in_bundle = 0;
+}
+
+int now_playing_update(FILE *out, uint32_t type, uint32_t code, const char *payload,
+                       size_t length) {
+  if ((type == 'ssnc') && (code == 'mdst')) {
+    if (in_bundle)
+      debug(1, "metadata bundle \"%s\" had no end -- its fields were discarded", bundle_key);
+    discard_bundle();
+    in_bundle = 1;
+    bundle_key = strndup(payload, length);
+    return 0;
+  }
+  if ((type == 'ssnc') && (code == 'mden')) {
+    if (!in_bundle)
+      return 0;
+    if ((strlen(bundle_key) != length) || (strncmp(bundle_key, payload, length) != 0))
+      debug(1, "metadata bundle \"%s\" ended as \"%.*s\"", bundle_key, (int)length, payload);
+    int changed = 0;
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+      if (fields[i].pending) {
+        changed |= merge(&fields[i], fields[i].pending);
+        fields[i].pending = NULL;
+      }
+    }
+    if (changed)
+      print_record(out, bundle_key);
+    discard_bundle();
+    return changed;
+  }
+  StateField *field = field_for(type, code);
+  if (field == NULL)
+    return 0;
+  char *value = field_value(field, payload, length);
+  if (field->in_bundle && in_bundle) {
+    free(field->pending);
+    field->pending = value;
+    return 0;
+  }
+  if (!merge(field, value))
+    return 0;
+  print_record(out, NULL);
+  return 1;
+}
+
+void now_playing_print_position(FILE *out, const PlaybackPosition *position) {
+  if (json_records) {
+    fprintf(out, "{\"now_playing\":{\"position_ms\":%" PRIu64, position->position_ms);
+    if (position->length_ms)
+      fprintf(out, ",\"length_ms\":%" PRIu64, position->length_ms);
+    fputs("}}\n", out);
+  } else {
+    fprintf(out, "now-playing position_ms=%" PRIu64, position->position_ms);
+    if (position->length_ms)
+      fprintf(out, " length_ms=%" PRIu64, position->length_ms);
+    fputc('\n', out);
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "position.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A model of what's playing, built up from the metadata items, for consumers that want the
+// current state rather than a line per item.
+//
+// The track fields sent between an mdst and an mden item -- title, artist, album and so on --
+// are collected as a bundle, keyed by the RTP timestamp in the mdst and mden payloads, and
+// merged into the state when the bundle ends. Player fields like the volume, the progress and
+// the client's name, address and model are merged as they arrive. Each time the state changes,
+// one record is printed, with only the fields that changed, e.g.:
+//
+// now-playing rtp=1234567 title="Stabat Mater" artist="Andreas Scholl" track_length=234567
+//
+// Strings are quoted, with '"', '\' and control characters escaped as in C. Alternatively, the
+// records can be printed as JSON objects, with numbers as numbers, e.g.:
+//
+// {"now_playing":{"rtp":1234567,"title":"Stabat Mater","track_length":234567}}
+//
+// The state isn't thread-safe -- it must be fed the items of one stream, in order.
+
+// Print the records as JSON objects if json is set.
+void now_playing_set_json(int json);
+
+// Update the state with an item's decoded payload, printing a record to out if the state has
+// changed. Returns 1 if a record was printed.
+int now_playing_update(FILE *out, uint32_t type, uint32_t code, const char *payload,
+                       size_t length);
+
+// Print a record of the playback position, e.g.:
+//
+// now-playing position_ms=83210 length_ms=234567
+//
+// The length is left out if it isn't known.
+void now_playing_print_position(FILE *out, const PlaybackPosition *position);
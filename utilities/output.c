@@ -0,0 +1,79 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "output.h"
+#include "clock.h"
+#include <poll.h>
+#include <stdio.h>
+
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static int output_unbuffered = 0;
+static uint64_t output_deadline_ns = OUTPUT_DEFAULT_DEADLINE_MS * 1000000ULL;
+static uint64_t output_pending_since = 0; // when unflushed output was first completed, or 0
+static uint64_t output_flushes = 0;
+
+void output_init(int unbuffered, unsigned int deadline_ms) {
+  output_unbuffered = unbuffered;
+  output_deadline_ns = (uint64_t)deadline_ms * 1000000;
+  if (!unbuffered)
+    setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+}
+
+void output_flush(void) {
+  if (output_pending_since) {
+    fflush(stdout);
+    output_flushes++;
+    output_pending_since = 0;
+  }
+}
+
+void output_item_done(int boundary) {
+  uint64_t now = monotonic_ns();
+  if (output_pending_since == 0)
+    output_pending_since = now ? now : 1;
+  if (output_unbuffered || boundary || (now - output_pending_since >= output_deadline_ns))
+    output_flush();
+}
+
+void output_wait_for_input(int fd) {
+  if (output_pending_since == 0)
+    return;
+  uint64_t waited = monotonic_ns() - output_pending_since;
+  if (waited < output_deadline_ns) {
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    int timeout_ms = (int)((output_deadline_ns - waited + 999999) / 1000000);
+    if (poll(&pfd, 1, timeout_ms) > 0)
+      return; // input has arrived in time
+  }
+  output_flush();
+}
+
+int output_get_deadline(uint64_t *deadline_ns) {
+  if (output_pending_since == 0)
+    return 0;
+  *deadline_ns = output_pending_since + output_deadline_ns;
+  return 1;
+}
+
+uint64_t output_flush_count(void) { return output_flushes; }
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// Output is built up in stdout's buffer and written out in batches, rather than with a write(2)
+// for every item. The buffer is flushed when it's full, at the end of a metadata bundle or
+// play session, or once output has been waiting for the deadline (OUTPUT_DEFAULT_DEADLINE_MS
+// unless set otherwise) -- including while waiting for more input -- so a display never lags
+// the player by more than that.
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+#define OUTPUT_DEFAULT_DEADLINE_MS 5
+
+// If unbuffered is set, stdout is flushed after every item, as it used to be.
+void output_init(int unbuffered, unsigned int deadline_ms);
+
+// Call when an item's output is complete; boundary is set if it ends a bundle or a session.
+void output_item_done(int boundary);
+
+// Call before blocking for input on fd: if output is waiting, wait for input no longer than
+// its deadline, and flush it if none arrives.
+void output_wait_for_input(int fd);
+
+void output_flush(void);
+
+// If output is waiting to be flushed, returns 1 and sets *deadline_ns to the CLOCK_MONOTONIC
+// time, in nanoseconds, by which it should be; otherwise returns 0.
+int output_get_deadline(uint64_t *deadline_ns);
+
+// the number of times output has been written out
+uint64_t output_flush_count(void);
@@ -0,0 +1,185 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "pipeline.h"
+#include "buffer-pool.h"
+#include "output.h"
+#include "ring.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a job's data buffer goes back to the pool after an item bigger than this
+#define PIPELINE_JOB_BUFFER_SIZE 4096
+
+typedef struct {
+  uint64_t sequence;
+  MetadataParserStatus status; // ITEM, JUNK or EOF
+  MetadataItem item;           // its data, if any, is a copy in buf
+  char *buf;
+  size_t buf_size;
+  FILE *out;  // a memory stream, reused from item to item
+  char *text; // and what's been written to it, up to text_length
+  size_t text_length;
+  int boundary;
+  int last; // the final job, at the end of the input
+} PipelineJob;
+
+typedef struct {
+  MetadataParser *parser;
+  ItemFormatFunction format;
+  PipelineEofFunction at_eof;
+  PipelineJob jobs[PIPELINE_JOBS];
+  Ring free_jobs; // emitter to reader
+  Ring work;      // reader to workers
+  Ring done;      // workers to emitter
+} Pipeline;
+
+static void *reader_thread(void *arg) {
+  Pipeline *pl = arg;
+  uint64_t sequence = 0;
+  int more = 1;
+  while (more) {
+    PipelineJob *job = ring_pop(&pl->free_jobs);
+    MetadataParserStatus status;
+    while (((status = metadata_parser_next(pl->parser, &job->item)) == METADATA_PARSER_ERROR) &&
+           (errno == EINTR))
+      ;
+    if (status == METADATA_PARSER_ERROR)
+      die("error reading the metadata pipe: %s", strerror(errno));
+    job->last = 0;
+    if (status == METADATA_PARSER_EOF) {
+      // an EOF job makes the emitter flush everything before it, while we wait for more input
+      job->status = status;
+      job->sequence = sequence++;
+      ring_push(&pl->work, job);
+      if (pl->at_eof(pl->parser))
+        continue;
+      job = ring_pop(&pl->free_jobs);
+      job->last = 1;
+      more = 0;
+    } else if (job->item.data) {
+      // the item's data is in the parser's buffer, which is about to be reused
+      size_t needed = job->item.data_length + 1;
+      if (needed > job->buf_size) {
+        buffer_pool_release(job->buf, job->buf_size);
+        job->buf = buffer_pool_acquire(needed, &job->buf_size);
+      }
+      memcpy(job->buf, job->item.data, job->item.data_length);
+      job->item.data = job->buf;
+    }
+    job->status = status;
+    job->sequence = sequence++;
+    ring_push(&pl->work, job);
+  }
+  return NULL;
+}
+
+static void *worker_thread(void *arg) {
+  Pipeline *pl = arg;
+  while (1) {
+    PipelineJob *job = ring_pop(&pl->work);
+    job->boundary = 0;
+    fseeko(job->out, 0, SEEK_SET);
+    if (job->status != METADATA_PARSER_EOF)
+      job->boundary = pl->format(job->out, job->status, &job->item);
+    fflush(job->out); // which sets text and text_length
+    ring_push(&pl->done, job);
+  }
+  return NULL;
+}
+
+static void emit(Pipeline *pl, PipelineJob *job) {
+  fwrite(job->text, 1, job->text_length, stdout);
+  if (job->status == METADATA_PARSER_EOF)
+    output_flush();
+  else
+    output_item_done(job->boundary);
+  if (job->buf_size > PIPELINE_JOB_BUFFER_SIZE) {
+    buffer_pool_release(job->buf, job->buf_size);
+    job->buf = buffer_pool_acquire(PIPELINE_JOB_BUFFER_SIZE, &job->buf_size);
+  }
+  ring_push(&pl->free_jobs, job);
+}
+
+void pipeline_run(MetadataParser *parser, int workers, ItemFormatFunction format,
+                  PipelineEofFunction at_eof) {
+  Pipeline *pl = calloc(1, sizeof(Pipeline));
+  if (pl == NULL)
+    die("could not allocate the pipeline");
+  pl->parser = parser;
+  pl->format = format;
+  pl->at_eof = at_eof;
+  ring_init(&pl->free_jobs, PIPELINE_JOBS);
+  ring_init(&pl->work, PIPELINE_JOBS);
+  ring_init(&pl->done, PIPELINE_JOBS);
+  for (int i = 0; i < PIPELINE_JOBS; i++) {
+    pl->jobs[i].buf = buffer_pool_acquire(PIPELINE_JOB_BUFFER_SIZE, &pl->jobs[i].buf_size);
+    pl->jobs[i].out = open_memstream(&pl->jobs[i].text, &pl->jobs[i].text_length);
+    if (pl->jobs[i].out == NULL)
+      die("could not open a memory stream: %s", strerror(errno));
+    ring_push(&pl->free_jobs, &pl->jobs[i]);
+  }
+  if (workers < 1)
+    workers = 1;
+  if (workers > PIPELINE_MAX_WORKERS)
+    workers = PIPELINE_MAX_WORKERS;
+  pthread_t thread;
+  for (int i = 0; i < workers; i++)
+    if (pthread_create(&thread, NULL, worker_thread, pl) != 0)
+      die("could not create a worker thread");
+  pthread_t reader;
+  if (pthread_create(&reader, NULL, reader_thread, pl) != 0)
+    die("could not create the reader thread");
+
+  // Emit the jobs in sequence. At most PIPELINE_JOBS are in flight, so a job that arrives early
+  // can wait in the slot for its sequence number modulo PIPELINE_JOBS.
+  PipelineJob *waiting[PIPELINE_JOBS] = {NULL};
+  uint64_t next = 0;
+  while (1) {
+    PipelineJob *job = waiting[next % PIPELINE_JOBS];
+    if (job) {
+      waiting[next % PIPELINE_JOBS] = NULL;
+      int last = job->last;
+      emit(pl, job);
+      next++;
+      if (last)
+        break;
+      continue;
+    }
+    uint64_t deadline;
+    if (output_get_deadline(&deadline)) {
+      job = ring_pop_until(&pl->done, deadline);
+      if (job == NULL) {
+        output_flush(); // nothing more has arrived in time
+        continue;
+      }
+    } else {
+      job = ring_pop(&pl->done);
+    }
+    waiting[job->sequence % PIPELINE_JOBS] = job;
+  }
+  pthread_join(reader, NULL);
+}
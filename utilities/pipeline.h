@@ -0,0 +1,25 @@
+#pragma once
+
+#include "metadata-parser.h"
+
+// An optional pipelined way of running the reader, so that a big item -- a picture or a large
+// plist -- doesn't hold up the reading and decoding of the items behind it.
+//
+// A reader thread parses the input and hands each item, with a sequence number, to a pool of
+// worker threads, which decode and format it. The calling thread emits the formatted items in
+// their original order. The stages are connected by rings (see ring.h); at most PIPELINE_JOBS
+// items are in flight at a time, so the reader waits if the emitter falls behind.
+
+#define PIPELINE_JOBS 64
+#define PIPELINE_MAX_WORKERS 32
+
+// Called by the reader thread at the end of the input. Returns non-zero once there's more
+// input to read, or zero if there won't be any.
+typedef int (*PipelineEofFunction)(MetadataParser *parser);
+
+// Run the pipeline on the parser's input with the given number of worker threads, writing the
+// output to stdout through the output module. The format function is called from the worker
+// threads, so it must be thread-safe. Returns when at_eof says there's no more input and
+// everything before it has been written out. The threads are left waiting for work.
+void pipeline_run(MetadataParser *parser, int workers, ItemFormatFunction format,
+                  PipelineEofFunction at_eof);
@@ -0,0 +1,191 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "position.h"
+#include <pthread.h>
+
+// if the time in a phbt or phb0 item is within this of the time it was received, it's taken to
+// be on our CLOCK_MONOTONIC clock -- the player is on the same host -- and used as the anchor
+#define POSITION_SAME_CLOCK_NS (10 * 1000000000ULL)
+
+static pthread_mutex_t position_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t rate = POSITION_DEFAULT_RATE;
+static int rate_from_source = 0; // the rate came from sdsc, so odsc doesn't override it
+static int anchored = 0;
+static uint32_t anchor_frame;
+static uint64_t anchor_ns;
+static int playing = 0;
+static int track_known = 0; // start_frame is set
+static uint32_t start_frame;
+static int end_known = 0;
+static uint32_t end_frame;
+
+// Parse decimal digits at *p, stopping at limit or the first non-digit. Doesn't depend on the
+// locale, unlike strtoull(), and is a lot quicker.
+static int parse_u64(const char **p, const char *limit, uint64_t *value) {
+  uint64_t v = 0;
+  const char *q = *p;
+  while ((q < limit) && (*q >= '0') && (*q <= '9'))
+    v = v * 10 + (uint64_t)(*q++ - '0');
+  if (q == *p)
+    return 0;
+  *value = v;
+  *p = q;
+  return 1;
+}
+
+// Parse count numbers separated by '/', e.g. "start/current/end".
+static int parse_fields(const char *payload, size_t length, uint64_t *values, int count) {
+  const char *p = payload, *limit = payload + length;
+  for (int i = 0; i < count; i++) {
+    if ((i > 0) && ((p == limit) || (*p++ != '/')))
+      return 0;
+    if (!parse_u64(&p, limit, &values[i]))
+      return 0;
+  }
+  return 1;
+}
+
+// Returns the frame rate in an audio format like "ALAC/44100/16/2" or "44100/S16_LE/2" -- the
+// first field that's a plausible rate -- or 0 if there isn't one.
+static uint32_t parse_rate(const char *payload, size_t length) {
+  const char *p = payload, *limit = payload + length;
+  while (p < limit) {
+    uint64_t v;
+    const char *start = p;
+    if (parse_u64(&p, limit, &v) && ((p == limit) || (*p == '/')) && (v >= 8000) &&
+        (v <= 1536000))
+      return v;
+    p = start;
+    while ((p < limit) && (*p != '/'))
+      p++;
+    if (p < limit)
+      p++;
+  }
+  return 0;
+}
+
+// The number of frames played in ns nanoseconds, without overflowing for any sensible ns.
+static uint64_t frames_in(uint64_t ns) { return ns / 1000 * rate / 1000000; }
+
+// The frame being played at now_ns, with the lock held.
+static uint32_t frame_at(uint64_t now_ns) {
+  if (!playing)
+    return anchor_frame;
+  if (now_ns >= anchor_ns)
+    return anchor_frame + (uint32_t)frames_in(now_ns - anchor_ns); // wraps around, as RTP does
+  return anchor_frame - (uint32_t)frames_in(anchor_ns - now_ns); // the anchor is still to come
+}
+
+static void set_anchor(uint32_t frame, uint64_t ns) {
+  anchor_frame = frame;
+  anchor_ns = ns;
+  anchored = 1;
+}
+
+void position_update(uint32_t type, uint32_t code, const char *payload, size_t length,
+                     uint64_t received_ns) {
+  if ((type != 'ssnc') || (payload == NULL))
+    return;
+  uint64_t v[3];
+  pthread_mutex_lock(&position_lock);
+  switch (code) {
+  case 'prgr':
+    if (parse_fields(payload, length, v, 3)) {
+      start_frame = v[0];
+      end_frame = v[2];
+      track_known = end_known = 1;
+      set_anchor(v[1], received_ns);
+      playing = 1;
+    }
+    break;
+  case 'phb0':
+  case 'phbt':
+    if (parse_fields(payload, length, v, 2)) {
+      uint64_t ns = received_ns;
+      if ((v[1] + POSITION_SAME_CLOCK_NS > received_ns) &&
+          (v[1] < received_ns + POSITION_SAME_CLOCK_NS))
+        ns = v[1];
+      set_anchor(v[0], ns);
+      if ((code == 'phb0') && !track_known) {
+        start_frame = v[0]; // the best there is without a prgr
+        track_known = 1;
+      }
+      playing = 1;
+    }
+    break;
+  case 'sdsc':
+  case 'odsc': {
+    uint32_t r = parse_rate(payload, length);
+    if ((r != 0) && ((code == 'sdsc') || !rate_from_source)) {
+      // keep the position where it is
+      if (anchored)
+        set_anchor(frame_at(received_ns), received_ns);
+      rate = r;
+      rate_from_source |= (code == 'sdsc');
+    }
+    break;
+  }
+  case 'paus':
+  case 'pfls':
+  case 'pend':
+    if (anchored && playing)
+      set_anchor(frame_at(received_ns), received_ns);
+    playing = 0;
+    break;
+  case 'pbeg':
+    // a new play session, so what's known about the last one no longer applies
+    anchored = track_known = end_known = playing = 0;
+    break;
+  case 'prsm':
+    if (anchored && !playing)
+      set_anchor(anchor_frame, received_ns);
+    playing = anchored;
+    break;
+  default:
+    break;
+  }
+  pthread_mutex_unlock(&position_lock);
+}
+
+int position_get(uint64_t now_ns, PlaybackPosition *position) {
+  pthread_mutex_lock(&position_lock);
+  int known = anchored && track_known;
+  if (known) {
+    uint32_t frame = frame_at(now_ns);
+    uint32_t into = frame - start_frame; // wraps around
+    uint32_t length = end_known ? end_frame - start_frame : 0;
+    if ((int32_t)into < 0)
+      into = 0; // it hasn't got to the start yet
+    else if ((length != 0) && (into > length))
+      into = length;
+    position->rate = rate;
+    position->playing = playing;
+    position->frame = frame;
+    position->position_ms = (uint64_t)into * 1000 / rate;
+    position->length_ms = (uint64_t)length * 1000 / rate;
+  }
+  pthread_mutex_unlock(&position_lock);
+  return known;
+}
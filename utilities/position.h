@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A playback position engine, so that a progress bar can show where the track has got to at
+// any moment, without the player having to keep sending phbt items.
+//
+// Positions in the stream are RTP timestamps -- 32-bit frame numbers that wrap around from
+// 2^32-1 to 0. The engine keeps an anchor, a frame and the CLOCK_MONOTONIC time it's played at,
+// taken from the latest prgr ("start/current/end"), phbt or phb0 ("frame/time") item, and
+// works out the current frame from the time elapsed since then at the source's frame rate.
+// The rate is taken from the sdsc item, e.g. "ALAC/44100/16/2", or, failing that, from the
+// odsc item, and is 44,100 frames per second until one arrives. The position freezes when play
+// is paused, flushed or ends, and carries on when it resumes; a pbeg starts afresh.
+//
+// The engine is thread-safe: it can be fed from one thread and asked for the position from
+// another, as often as need be.
+
+#define POSITION_DEFAULT_RATE 44100
+
+typedef struct {
+  uint32_t rate;        // frames per second
+  int playing;          // the position is advancing
+  uint32_t frame;       // the RTP timestamp being played
+  uint64_t position_ms; // since the start of the track
+  uint64_t length_ms;   // of the track, or 0 if it isn't known
+} PlaybackPosition;
+
+// Update the engine with an item's decoded payload, received at received_ns on the
+// CLOCK_MONOTONIC clock. Items it has no use for are ignored.
+void position_update(uint32_t type, uint32_t code, const char *payload, size_t length,
+                     uint64_t received_ns);
+
+// Work out the position at now_ns, on the CLOCK_MONOTONIC clock. Returns 0, leaving position
+// alone, if it isn't known yet -- neither a prgr nor a phb0 item has been seen.
+int position_get(uint64_t now_ns, PlaybackPosition *position);
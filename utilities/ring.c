@@ -0,0 +1,102 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#define _GNU_SOURCE // for sem_clockwait()
+#include "ring.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+// This is Dmitry Vyukov's bounded queue, with the semaphores guaranteeing that a cell will be
+// ready for whoever claims it. It may not be ready quite yet -- another thread may have claimed
+// the cell before it and not yet finished with it -- so there may be a short wait for that.
+
+void ring_init(Ring *ring, size_t capacity) {
+  size_t size = 1;
+  while (size < capacity)
+    size <<= 1;
+  ring->cells = malloc(size * sizeof(RingCell));
+  if (ring->cells == NULL)
+    die("could not allocate a ring of %zu cells", size);
+  for (size_t i = 0; i < size; i++)
+    atomic_init(&ring->cells[i].sequence, i);
+  ring->mask = size - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  sem_init(&ring->items, 0, 0);
+  sem_init(&ring->spaces, 0, size);
+}
+
+void ring_free(Ring *ring) {
+  sem_destroy(&ring->items);
+  sem_destroy(&ring->spaces);
+  free(ring->cells);
+  ring->cells = NULL;
+}
+
+static void wait_for(sem_t *sem) {
+  while (sem_wait(sem) != 0)
+    ; // only EINTR is possible
+}
+
+static void wait_for_cell(RingCell *cell, size_t sequence) {
+  while (atomic_load_explicit(&cell->sequence, memory_order_acquire) != sequence)
+    sched_yield();
+}
+
+void ring_push(Ring *ring, void *value) {
+  wait_for(&ring->spaces);
+  size_t position = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+  RingCell *cell = &ring->cells[position & ring->mask];
+  wait_for_cell(cell, position);
+  cell->value = value;
+  atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+  sem_post(&ring->items);
+}
+
+static void *take(Ring *ring) {
+  size_t position = atomic_fetch_add_explicit(&ring->tail, 1, memory_order_relaxed);
+  RingCell *cell = &ring->cells[position & ring->mask];
+  wait_for_cell(cell, position + 1);
+  void *value = cell->value;
+  atomic_store_explicit(&cell->sequence, position + ring->mask + 1, memory_order_release);
+  sem_post(&ring->spaces);
+  return value;
+}
+
+void *ring_pop(Ring *ring) {
+  wait_for(&ring->items);
+  return take(ring);
+}
+
+void *ring_pop_until(Ring *ring, uint64_t deadline_ns) {
+  struct timespec deadline = {.tv_sec = deadline_ns / 1000000000,
+                              .tv_nsec = deadline_ns % 1000000000};
+  int r;
+  while (((r = sem_clockwait(&ring->items, CLOCK_MONOTONIC, &deadline)) != 0) &&
+         (errno == EINTR))
+    ;
+  return r == 0 ? take(ring) : NULL;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <semaphore.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A bounded queue of pointers for passing work between threads. Any number of threads may
+// push and pop, so it serves as an SPSC or an MPSC ring. Only the handoff through a cell is
+// lock-free: cells are claimed with atomic counters rather than under a lock. Pushing and popping
+// do block -- a pair of counting semaphores keep track of the items and the free spaces, and a
+// thread sleeps in them when the ring is empty (to pop) or full (to push).
+
+typedef struct {
+  atomic_size_t sequence; // which lap of the ring the cell is ready for
+  void *value;
+} RingCell;
+
+typedef struct {
+  RingCell *cells;
+  size_t mask;                      // capacity - 1; the capacity is a power of two
+  alignas(64) atomic_size_t head;   // where the next push goes
+  alignas(64) atomic_size_t tail;   // where the next pop comes from
+  sem_t items;
+  sem_t spaces;
+} Ring;
+
+// The capacity is rounded up to a power of two.
+void ring_init(Ring *ring, size_t capacity);
+void ring_free(Ring *ring);
+
+// Add value to the ring, waiting for space if it's full.
+void ring_push(Ring *ring, void *value);
+
+// Take the oldest value from the ring, waiting for one if it's empty.
+void *ring_pop(Ring *ring);
+
+// As ring_pop(), but give up and return NULL if nothing arrives by deadline_ns, a
+// CLOCK_MONOTONIC time in nanoseconds.
+void *ring_pop_until(Ring *ring, uint64_t deadline_ns);
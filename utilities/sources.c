@@ -0,0 +1,206 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "sources.h"
+#include "clock.h"
+#include "json.h"
+#include "output.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the most items to take from a source before seeing to the others
+#define SOURCES_ITEMS_PER_TURN 64
+
+typedef struct {
+  char *name;
+  const char *path;
+  int fd;
+  MetadataParser parser;
+  int ready; // on the ready list -- see sources_run()
+} Source;
+
+typedef enum {
+  SOURCE_DROPPED = 0, // the writer has gone and SOURCES_EXIT_ON_EOF is set
+  SOURCE_WAITING,     // everything that has arrived has been dealt with
+  SOURCE_READY        // its turn ended with input still to be dealt with
+} SourceState;
+
+static int epoll_fd = -1;
+
+static void open_source(Source *source) {
+  // O_NONBLOCK, so that the open doesn't wait for a writer and reads don't wait for input
+  source->fd = open(source->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (source->fd < 0)
+    die("could not open \"%s\": %s", source->path, strerror(errno));
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = source};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, source->fd, &ev) != 0)
+    die("can't wait for input from \"%s\" -- is it a pipe? (%s)", source->path, strerror(errno));
+  metadata_parser_init(&source->parser, source->fd);
+  metadata_parser_idle(&source->parser); // no buffer until there's input
+}
+
+static void close_source(Source *source) {
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+  close(source->fd);
+  metadata_parser_free(&source->parser);
+}
+
+// Write what's been formatted, with the source's name at the start of every line -- or, if
+// the lines are JSON objects, as their first member.
+static void emit(const Source *source, const char *text, size_t length, int json) {
+  const char *end = text + length;
+  while (text < end) {
+    const char *nl = memchr(text, '\n', end - text);
+    const char *next = nl ? nl + 1 : end;
+    if (json && (*text == '{') && (text[1] != '}')) {
+      fputs("{\"source\":", stdout);
+      json_print_string(stdout, source->name, strlen(source->name));
+      fputc(',', stdout);
+      text++;
+    } else if (!json) {
+      fprintf(stdout, "[%s] ", source->name);
+    }
+    fwrite(text, 1, next - text, stdout);
+    text = next;
+  }
+}
+
+// Deal with up to SOURCES_ITEMS_PER_TURN items from the source.
+static SourceState serve(Source *source, ItemFormatFunction format, FILE *record,
+                         char **text, size_t *length, int flags) {
+  for (int i = 0; i < SOURCES_ITEMS_PER_TURN; i++) {
+    MetadataItem item;
+    MetadataParserStatus status = metadata_parser_next(&source->parser, &item);
+    if (status == METADATA_PARSER_ERROR) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN) {
+        metadata_parser_idle(&source->parser); // that's all for now
+        return SOURCE_WAITING;
+      }
+      die("error reading \"%s\": %s", source->path, strerror(errno));
+    }
+    if (status == METADATA_PARSER_EOF) {
+      // the writer has gone -- reopen the pipe to wait for the next one
+      output_flush();
+      close_source(source);
+      if (flags & SOURCES_EXIT_ON_EOF)
+        return SOURCE_DROPPED;
+      open_source(source);
+      return SOURCE_WAITING;
+    }
+    fseeko(record, 0, SEEK_SET);
+    int boundary = format(record, status, &item);
+    fflush(record);
+    emit(source, *text, *length, flags & SOURCES_JSON);
+    output_item_done(boundary);
+  }
+  // There may be more items in the parser's buffer, which epoll won't say anything about.
+  return SOURCE_READY;
+}
+
+void sources_run(char *const *sources, int count, ItemFormatFunction format, int flags) {
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0)
+    die("could not create an epoll instance: %s", strerror(errno));
+  Source *source = calloc(count, sizeof(Source));
+  // the sources to serve on the next pass whether or not epoll reports them
+  Source **ready = malloc(count * sizeof(Source *));
+  if ((source == NULL) || (ready == NULL))
+    die("could not allocate the sources");
+  int ready_count = 0;
+  for (int i = 0; i < count; i++) {
+    const char *equals = strchr(sources[i], '=');
+    if (equals) {
+      source[i].name = strndup(sources[i], equals - sources[i]);
+      source[i].path = equals + 1;
+    } else {
+      const char *slash = strrchr(sources[i], '/');
+      source[i].name = strdup(slash ? slash + 1 : sources[i]);
+      source[i].path = sources[i];
+    }
+    open_source(&source[i]);
+  }
+
+  // every item is formatted into this, so that its lines can be tagged
+  char *text = NULL;
+  size_t length = 0;
+  FILE *record = open_memstream(&text, &length);
+  if (record == NULL)
+    die("could not open a memory stream: %s", strerror(errno));
+
+  struct epoll_event events[16];
+  int open_sources = count;
+  while (open_sources > 0) {
+    int timeout_ms = -1;
+    uint64_t deadline;
+    if (ready_count > 0) {
+      timeout_ms = 0; // just see whether any others have input
+    } else if (output_get_deadline(&deadline)) {
+      uint64_t now = monotonic_ns();
+      timeout_ms = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+    }
+    int n = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(events[0]), timeout_ms);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      die("epoll_wait failed: %s", strerror(errno));
+    }
+    if ((n == 0) && (ready_count == 0))
+      output_flush(); // nothing more has arrived in time
+    for (int i = 0; i < n; i++) {
+      Source *s = events[i].data.ptr;
+      if (!s->ready) {
+        s->ready = 1;
+        ready[ready_count++] = s;
+      }
+    }
+    // Serve each source with input in turn, keeping those that still have some on the list.
+    int served = ready_count;
+    ready_count = 0;
+    for (int i = 0; i < served; i++) {
+      Source *s = ready[i];
+      s->ready = 0;
+      SourceState state = serve(s, format, record, &text, &length, flags);
+      if (state == SOURCE_DROPPED) {
+        open_sources--;
+      } else if (state == SOURCE_READY) {
+        s->ready = 1;
+        ready[ready_count++] = s;
+      }
+    }
+  }
+  fclose(record);
+  free(text);
+  for (int i = 0; i < count; i++)
+    free(source[i].name);
+  free(ready);
+  free(source);
+  close(epoll_fd);
+}
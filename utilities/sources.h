@@ -0,0 +1,22 @@
+#pragma once
+
+#include "metadata-parser.h"
+
+// Read from several metadata pipes in one process -- for example, one for each instance of
+// Shairport Sync on a host. The pipes are multiplexed with epoll, each has its own parser, and
+// every line of output is tagged with the name of the pipe it came from, like this:
+//
+// [kitchen] Title: "Stabat Mater".
+//
+// A source is given as NAME=PATH or just PATH, in which case the name is the last component
+// of the path. When the writer of a pipe closes it, the pipe is reopened to wait for the next
+// writer, unless SOURCES_EXIT_ON_EOF is set, in which case the source is dropped. A source
+// that's idle holds no buffer, so memory use depends on the traffic rather than on the number
+// of sources.
+
+#define SOURCES_EXIT_ON_EOF 1 // drop a source when its writer closes it
+#define SOURCES_JSON 2        // the output is JSON objects, tagged with a "source" member instead
+
+// Read from the sources, writing the output to stdout through the output module.
+// Returns only if SOURCES_EXIT_ON_EOF is set, once every source has been dropped.
+void sources_run(char *const *sources, int count, ItemFormatFunction format, int flags);
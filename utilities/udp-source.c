@@ -0,0 +1,213 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#define _GNU_SOURCE // for recvmmsg()
+#include "udp-source.h"
+#include "buffer-pool.h"
+#include "clock.h"
+#include "item-filter.h"
+#include "output.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define CHUNK_HEADER_SIZE 24
+
+// An item being put together from its chunks. The chunks are expected in order -- if one goes
+// missing, the item is dropped.
+typedef struct {
+  uint32_t type;
+  uint32_t code;
+  uint32_t chunks;     // how many there'll be
+  uint32_t next_chunk; // the index of the one expected next
+  char *buf;
+  size_t size;
+  size_t length;
+} Assembly;
+
+static uint32_t get_uint32(const unsigned char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(uint32_t));
+  return ntohl(v);
+}
+
+static int open_socket(const char *address) {
+  char *copy = strdup(address);
+  char *host = NULL;
+  char *port = copy;
+  char *colon = strrchr(copy, ':');
+  if (colon) {
+    *colon = '\0';
+    host = copy;
+    port = colon + 1;
+    if ((host[0] == '[') && (colon[-1] == ']')) { // an IPv6 address in brackets
+      host++;
+      colon[-1] = '\0';
+    }
+  }
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM, .ai_flags = AI_PASSIVE};
+  struct addrinfo *ai;
+  int r = getaddrinfo(host, port, &hints, &ai);
+  if (r != 0)
+    die("can't use the address \"%s\": %s", address, gai_strerror(r));
+  int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+  if (fd < 0)
+    die("could not create a UDP socket: %s", strerror(errno));
+  // make room for bursts of items, e.g. a picture sent in many chunks
+  int rcvbuf = 4 * 1024 * 1024;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+    die("could not bind to \"%s\": %s", address, strerror(errno));
+  freeaddrinfo(ai);
+  free(copy);
+  return fd;
+}
+
+static uint64_t sequence; // of the next item
+static uint64_t received_ns; // when the datagrams being dealt with were received
+
+static void deliver(ItemFormatFunction format, uint32_t type, uint32_t code, char *data,
+                    size_t length) {
+  MetadataItem item = {.type = type,
+                       .code = code,
+                       .length = length,
+                       .data = length ? data : NULL,
+                       .data_length = length,
+                       .flags = METADATA_ITEM_DECODED,
+                       .sequence = sequence++,
+                       .received_ns = received_ns};
+  output_item_done(format(stdout, METADATA_PARSER_ITEM, &item));
+}
+
+static void receive_chunk(Assembly *a, ItemFormatFunction format, const unsigned char *d,
+                          size_t length) {
+  uint32_t index = get_uint32(d + 8);
+  uint32_t chunks = get_uint32(d + 12);
+  uint32_t type = get_uint32(d + 16);
+  uint32_t code = get_uint32(d + 20);
+  size_t chunk_length = length - CHUNK_HEADER_SIZE;
+  if (!item_filter_accepts(type, code))
+    return; // not wanted, so not worth putting together
+  if ((chunks == 0) || ((uint64_t)chunks * chunk_length > UDP_SOURCE_MAX_ITEM)) {
+    debug(1, "a chunk of an impossibly large item was dropped");
+    return;
+  }
+  if (index == 0) {
+    if (a->next_chunk != 0)
+      debug(1, "an incomplete chunked item was dropped");
+    a->type = type;
+    a->code = code;
+    a->chunks = chunks;
+    a->length = 0;
+  } else if ((index != a->next_chunk) || (type != a->type) || (code != a->code) ||
+             (chunks != a->chunks)) {
+    if (a->next_chunk != 0)
+      debug(1, "a chunk is missing, so a chunked item was dropped");
+    a->next_chunk = 0;
+    return;
+  }
+  // leave room for a NUL after the payload
+  if (a->length + chunk_length + 1 > a->size) {
+    size_t wanted = index == 0 ? (size_t)chunks * chunk_length + 1 : 2 * (a->length + chunk_length + 1);
+    size_t size;
+    char *buf = buffer_pool_acquire(wanted, &size);
+    if (a->length)
+      memcpy(buf, a->buf, a->length);
+    buffer_pool_release(a->buf, a->size);
+    a->buf = buf;
+    a->size = size;
+  }
+  memcpy(a->buf + a->length, d + CHUNK_HEADER_SIZE, chunk_length);
+  a->length += chunk_length;
+  a->next_chunk = index + 1;
+  if (a->next_chunk == a->chunks) {
+    deliver(format, a->type, a->code, a->buf, a->length);
+    a->next_chunk = 0;
+    // don't hold on to a big buffer between pictures
+    buffer_pool_release(a->buf, a->size);
+    a->buf = NULL;
+    a->size = 0;
+  }
+}
+
+void udp_source_run(const char *address, ItemFormatFunction format) {
+  int fd = open_socket(address);
+  // one extra byte in each buffer, for a NUL after the payload
+  char *buffers = malloc(UDP_SOURCE_BATCH * (UDP_SOURCE_MAX_DATAGRAM + 1));
+  if (buffers == NULL)
+    die("could not allocate the datagram buffers");
+  struct mmsghdr messages[UDP_SOURCE_BATCH];
+  struct iovec iovecs[UDP_SOURCE_BATCH];
+  for (int i = 0; i < UDP_SOURCE_BATCH; i++) {
+    iovecs[i].iov_base = buffers + i * (UDP_SOURCE_MAX_DATAGRAM + 1);
+    iovecs[i].iov_len = UDP_SOURCE_MAX_DATAGRAM;
+    memset(&messages[i], 0, sizeof(struct mmsghdr));
+    messages[i].msg_hdr.msg_iov = &iovecs[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  Assembly assembly = {0};
+  while (1) {
+    int timeout_ms = -1;
+    uint64_t deadline;
+    if (output_get_deadline(&deadline)) {
+      uint64_t now = monotonic_ns();
+      timeout_ms = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+    }
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    int r = poll(&pfd, 1, timeout_ms);
+    if ((r < 0) && (errno != EINTR))
+      die("poll failed: %s", strerror(errno));
+    if (r == 0)
+      output_flush(); // nothing more has arrived in time
+    if (r <= 0)
+      continue;
+    int n = recvmmsg(fd, messages, UDP_SOURCE_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+      die("error receiving metadata: %s", strerror(errno));
+    }
+    received_ns = monotonic_ns();
+    for (int i = 0; i < n; i++) {
+      unsigned char *d = iovecs[i].iov_base;
+      size_t length = messages[i].msg_len;
+      if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+        debug(1, "a datagram too big to receive was dropped");
+      } else if (length < 8) {
+        debug(1, "a datagram too short to be an item was dropped");
+      } else if ((get_uint32(d) == 'ssnc') && (get_uint32(d + 4) == 'chnk')) {
+        if (length >= CHUNK_HEADER_SIZE)
+          receive_chunk(&assembly, format, d, length);
+      } else if (item_filter_accepts(get_uint32(d), get_uint32(d + 4))) {
+        deliver(format, get_uint32(d), get_uint32(d + 4), (char *)d + 8, length - 8);
+      }
+      messages[i].msg_hdr.msg_flags = 0;
+    }
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "metadata-parser.h"
+
+// Read metadata from the UDP socket Shairport Sync can send it to, instead of from the pipe.
+//
+// Each datagram holds an item: its type and code as 32-bit big-endian numbers, followed by the
+// payload, not base64-encoded. An item too big for one datagram is sent in chunks, each with a
+// 24-byte header:
+//
+//   "ssnc" "chnk" <chunk index> <number of chunks> <type> <code>
+//
+// all 32-bit big-endian numbers, followed by its part of the payload. The chunks are
+// reassembled, in a buffer from the buffer pool, before the item is passed on.
+//
+// Datagrams are received in batches of up to UDP_SOURCE_BATCH with recvmmsg().
+
+#define UDP_SOURCE_BATCH 32
+#define UDP_SOURCE_MAX_DATAGRAM 65536
+#define UDP_SOURCE_MAX_ITEM (64 * 1024 * 1024) // chunked items bigger than this are dropped
+
+// Receive metadata on [HOST:]PORT -- the host defaults to all local addresses -- and write
+// the output to stdout through the output module. It doesn't return.
+void udp_source_run(const char *address, ItemFormatFunction format);
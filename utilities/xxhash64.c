@@ -0,0 +1,104 @@
+/*
+MIT License
+
+Copyright (c) 2026 Mike Brady 4265913+mikebrady@users.noreply.github.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "xxhash64.h"
+#include <endian.h>
+#include <string.h>
+
+static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// the input is read in little-endian order, whatever the alignment
+static uint64_t read64(const unsigned char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(uint64_t));
+  return le64toh(v);
+}
+
+static uint32_t read32(const unsigned char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(uint32_t));
+  return le32toh(v);
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input) {
+  acc += input * prime2;
+  acc = rotl(acc, 31);
+  return acc * prime1;
+}
+
+static uint64_t merge_round(uint64_t acc, uint64_t value) {
+  acc ^= round64(0, value);
+  return acc * prime1 + prime4;
+}
+
+uint64_t xxhash64(const void *data, size_t length, uint64_t seed) {
+  const unsigned char *p = data;
+  const unsigned char *end = p + length;
+  uint64_t h;
+  if (length >= 32) {
+    // four lanes, each taking every fourth 8-byte word of each 32-byte stripe
+    uint64_t v1 = seed + prime1 + prime2;
+    uint64_t v2 = seed + prime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - prime1;
+    const unsigned char *limit = end - 32;
+    do {
+      v1 = round64(v1, read64(p));
+      v2 = round64(v2, read64(p + 8));
+      v3 = round64(v3, read64(p + 16));
+      v4 = round64(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge_round(h, v1);
+    h = merge_round(h, v2);
+    h = merge_round(h, v3);
+    h = merge_round(h, v4);
+  } else {
+    h = seed + prime5;
+  }
+  h += (uint64_t)length;
+  // the remaining 0 to 31 bytes
+  for (; p + 8 <= end; p += 8)
+    h = rotl(h ^ round64(0, read64(p)), 27) * prime1 + prime4;
+  if (p + 4 <= end) {
+    h = rotl(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+    p += 4;
+  }
+  for (; p < end; p++)
+    h = rotl(h ^ (*p * prime5), 11) * prime1;
+  // avalanche
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The XXH64 hash of length bytes of data -- a fast, well-distributed, non-cryptographic hash.
+// See https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+uint64_t xxhash64(const void *data, size_t length, uint64_t seed);